@@ -1,265 +1,1960 @@
 #include "diskio.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_ssi.h"
 #include "driverlib/sysctl.h"
 #include "driverlib/gpio.h"
 #include "driverlib/ssi.h"
 #include "driverlib/pin_map.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/cpu.h"
+#include "driverlib/udma.h"
+#include "driverlib/systick.h"
 
-// SPI pins: PA2=SCK, PA5=MOSI, PA4=MISO
-// CS pin: PA3 (GPIO)
+// Physical drive n is the card on the n-th SSI of this list. The SSI pins
+// and the CS pin (the SSI's FSS pin, driven as a GPIO) share one port:
+//   drive 0: SSI0  PA2=SCK, PA4=MISO, PA5=MOSI, PA3=CS
+//   drive 1: SSI2  PB4=SCK, PB6=MISO, PB7=MOSI, PB5=CS
+//   drive 2: SSI3  PD0=SCK, PD2=MISO, PD3=MOSI, PD1=CS
+//   drive 3: SSI1  PF2=SCK, PF0=MISO, PF1=MOSI, PF3=CS (LaunchPad LED pins)
+#if SD_DRIVES < 1 || SD_DRIVES > 4
+#error "SD_DRIVES must be 1 to 4"
+#endif
 
-#define CS_PORT GPIO_PORTA_BASE
-#define CS_PIN  GPIO_PIN_3
+// 1: move the data phase of each block with uDMA (SSI0 RX = ch10, TX = ch11,
+// SSI2 ch12/13, SSI3 ch14/15, SSI1 ch24/25)
+// 0: move it through the SSI FIFOs from the SSI interrupt
+#ifndef SD_USE_DMA
+#define SD_USE_DMA 1
+#endif
 
-static volatile DSTATUS Stat = STA_NOINIT;
+// 1: clock block data in 16-bit SSI frames. In SPI mode 0 the SSI idles one
+// bit time between frames, so this trims the data phase by about 6%.
+// Commands, tokens and CRCs always use 8-bit frames.
+#ifndef SD_WIDE_FRAMES
+#define SD_WIDE_FRAMES 1
+#endif
+
+// Upper limit of the SPI clock after init, in Hz: the SSI master limit of the
+// TM4C123. Lower it for long wires or boards with poor signal integrity; the
+// MMC_SET_MAX_CLK ioctl sets a further cap at run time.
+#ifndef SD_MAX_CLOCK
+#define SD_MAX_CLOCK 25000000
+#endif
+
+// Requests disk_read_async()/disk_write_async() can hold per drive, running
+// one included
+#ifndef SD_QUEUE_LEN
+#define SD_QUEUE_LEN 4
+#endif
+
+// 1: enable CRC checking with CMD59. Commands and write blocks carry real
+// CRCs and read blocks are checked, so transfer errors at high clock rates
+// are caught and retried instead of being stored.
+#ifndef SD_USE_CRC
+#define SD_USE_CRC 1
+#endif
+
+// Retries of a request at a block that keeps failing
+#ifndef SD_RETRIES
+#define SD_RETRIES 3
+#endif
+
+// Sectors per stripe unit of the striped drive. Consecutive units go to
+// consecutive cards, so a request of SD_DRIVES units keeps every card busy.
+#ifndef SD_STRIPE_SECTORS
+#define SD_STRIPE_SECTORS 16
+#endif
+
+// Sleep until cond holds. Interrupts are masked between the test and WFI so
+// a completion in that window still wakes the core (WFI ignores PRIMASK).
+#define WAIT_FOR(cond) \
+    while (!(cond)) { CPUcpsid(); if (!(cond)) CPUwfi(); CPUcpsie(); }
+
+// ----------------------- Drives -----------------------
+// Wiring of one card
+typedef struct {
+    uint32_t ssi_base;
+    uint32_t ssi_periph;
+    uint32_t ssi_int;
+    uint32_t gpio_periph;
+    uint32_t gpio_base;
+    uint8_t  clk_pin, rx_pin, tx_pin, cs_pin;
+    uint32_t clk_cfg, rx_cfg, tx_cfg;       // GPIOPinConfigure() values
+    uint32_t dma_rx, dma_tx;                // uDMAChannelAssign() values
+} SD_PORT;
+
+static const SD_PORT Ports[4] = {
+    { SSI0_BASE, SYSCTL_PERIPH_SSI0, INT_SSI0,
+      SYSCTL_PERIPH_GPIOA, GPIO_PORTA_BASE,
+      GPIO_PIN_2, GPIO_PIN_4, GPIO_PIN_5, GPIO_PIN_3,
+      GPIO_PA2_SSI0CLK, GPIO_PA4_SSI0RX, GPIO_PA5_SSI0TX,
+      UDMA_CH10_SSI0RX, UDMA_CH11_SSI0TX },
+    { SSI2_BASE, SYSCTL_PERIPH_SSI2, INT_SSI2,
+      SYSCTL_PERIPH_GPIOB, GPIO_PORTB_BASE,
+      GPIO_PIN_4, GPIO_PIN_6, GPIO_PIN_7, GPIO_PIN_5,
+      GPIO_PB4_SSI2CLK, GPIO_PB6_SSI2RX, GPIO_PB7_SSI2TX,
+      UDMA_CH12_SSI2RX, UDMA_CH13_SSI2TX },
+    { SSI3_BASE, SYSCTL_PERIPH_SSI3, INT_SSI3,
+      SYSCTL_PERIPH_GPIOD, GPIO_PORTD_BASE,
+      GPIO_PIN_0, GPIO_PIN_2, GPIO_PIN_3, GPIO_PIN_1,
+      GPIO_PD0_SSI3CLK, GPIO_PD2_SSI3RX, GPIO_PD3_SSI3TX,
+      UDMA_CH14_SSI3RX, UDMA_CH15_SSI3TX },
+    { SSI1_BASE, SYSCTL_PERIPH_SSI1, INT_SSI1,
+      SYSCTL_PERIPH_GPIOF, GPIO_PORTF_BASE,
+      GPIO_PIN_2, GPIO_PIN_0, GPIO_PIN_1, GPIO_PIN_3,
+      GPIO_PF2_SSI1CLK, GPIO_PF0_SSI1RX, GPIO_PF1_SSI1TX,
+      UDMA_CH24_SSI1RX, UDMA_CH25_SSI1TX }
+};
+
+// uDMA channel number of a uDMAChannelAssign() value
+#define DMA_CH(m)   ((m) & 0x1F)
+
+// Registers read once by disk_initialize(), served by disk_ioctl()
+typedef struct {
+    BYTE  type;             // CT_xxx, CT_HS if the High Speed switch succeeded
+    BYTE  csd[16];
+    BYTE  cid[16];
+    BYTE  ocr[4];
+    BYTE  sdstat[64];       // ACMD13 SD Status (SD cards only)
+    DWORD sectors;          // Capacity in 512-byte sectors
+    DWORD au_sectors;       // Erase block size in sectors, 0: unknown
+} CARD_INFO;
+
+typedef enum {
+    REQ_READ,
+    REQ_WRITE,
+    REQ_ERASE       // buff points to the first and last sector (DWORD[2])
+} REQ_OP;
+
+typedef struct {
+    BYTE*         buff;         // buff and sector advance as blocks complete
+    DWORD         sector;
+    BYTE          count;        // Blocks left
+    REQ_OP        op;
+    BYTE          cls;          // DISK_DATA or DISK_META
+    DWORD         queued_us;    // time_us() when queued
+    DISK_CALLBACK cb;
+    void*         arg;
+} DISK_REQ;
+
+typedef enum {
+    AS_IDLE,
+    AS_SELECT,      // CS high, two dummy bytes; then the command
+    AS_READY,       // Polling for the end of a deferred write
+    AS_CMD,         // Command frame, stuff byte (CMD12) and R1 polls
+    AS_TOKEN,       // Polling for a read start block token
+    AS_RDATA,       // Rest of a read data block
+    AS_RCRC,        // CRC of a read data block
+    AS_WREADY,      // Polling for the end of busy before a write token
+    AS_WTOKEN,      // Write start block token
+    AS_WDATA,       // Write data block
+    AS_WRESP,       // Dummy CRC and data response
+    AS_STOP,        // StopTran token and the stuff byte after it
+    AS_BUSY,        // Polling for the end of CMD12 busy
+    AS_DESELECT     // CS high, one dummy byte; then the callback
+} ASTATE;
+
+// State of one physical drive. Each drive has its own SSI, interrupt and
+// uDMA channels, so the request engines of all drives run at the same time.
+typedef struct {
+    const SD_PORT* port;            // NULL until the drive is first used
+    volatile DSTATUS stat;
+    uint32_t spi_clock;             // Current SSI bit rate
+    uint32_t spi_bits;              // Current SSI frame width
+    uint32_t clk_cap;               // MMC_SET_MAX_CLK, 0: none
+    CARD_INFO card;
+    DISK_TIMING timing;             // MMC_GET_TIMING
+    uint8_t t_cmd;                  // Command being timed, 0xFF: none
+    DWORD t_start;
+    volatile bool card_busy;        // See set_busy()
+    DWORD busy_until;               // Deadline of the busy period
+    volatile bool dma_fault;        // Set by uDMAErrorHandler
+
+    // Background exchange
+    BYTE* x_rx;
+    const BYTE* x_tx;
+    UINT x_len;
+    volatile bool x_active;
+#if !SD_USE_DMA
+    UINT x_sent, x_rcvd;
+#endif
+
+    // Request engine
+    DISK_REQ a_queue[SD_QUEUE_LEN]; // In order of arrival
+    volatile uint8_t a_count;       // Queued requests, including the running one
+    DISK_QSTATS qstats;             // MMC_GET_QSTATS
+    DISK_REQ* a_req;                // Running request
+    ASTATE a_state;
+    uint8_t a_cmd;                  // Command of the current stage
+    DRESULT a_res;
+    DWORD a_arg;                    // Argument of a_cmd
+    DWORD a_until;                  // Deadline of the current wait
+    UINT a_done;                    // Read block bytes received or under way
+    uint16_t a_crc;                 // CRC of the write block being sent
+    uint8_t a_tries;                // Retries at the same block
+    DWORD a_first;                  // First sector of the current attempt
+    BYTE a_buf[20];                 // Command frame and poll bytes
+    bool a_closing;                 // CMD12 closes the stream, then a_req starts
+
+    // Read stream (see async_start())
+    bool s_open;                    // CMD18 left running, CS low
+    DWORD s_next;                   // Sector the open stream delivers next
+    DWORD r_next;                   // Sector after the last read
+} SD_DRIVE;
+
+static SD_DRIVE Drives[SD_DRIVES];
+static uint32_t spi_sysclk;             // SysCtlClockGet() at spi_set_clock()
+
+// Drive drv, set up on first use
+static SD_DRIVE* drive_get(BYTE drv)
+{
+    SD_DRIVE* d = &Drives[drv];
+
+    if (!d->port) {
+        d->port = &Ports[drv];
+        d->stat = STA_NOINIT;
+        d->t_cmd = 0xFF;
+        d->a_crc = 0xFFFF;
+    }
+    return d;
+}
+
+#if SD_USE_DMA
+// Channel control table. The uDMA controller requires 1024-byte alignment.
+#if defined(ccs)
+#pragma DATA_ALIGN(dma_table, 1024)
+static tDMAControlTable dma_table[64];
+#else
+static tDMAControlTable dma_table[64] __attribute__((aligned(1024)));
+#endif
+
+static const uint16_t dma_ones = 0xFFFF; // TX source while receiving a block
+static uint16_t dma_sink;               // RX sink while transmitting a block
+#endif
+
+// ----------------------- Timebase -----------------------
+// disk_timerproc() is called every millisecond from the SysTick interrupt.
+// Timeouts are deadlines on that count, so they hold at any SPI or CPU clock.
+#define INIT_MS     1000        // ACMD41/CMD1 initialization
+#define TOKEN_MS    200         // Read start block token
+#define BUSY_MS     500         // End of programming or of CMD12
+#define ERASE_MS    30000       // End of an erase
+
+static volatile DWORD Timer_ms;
+
+void disk_timerproc(void)
+{
+    Timer_ms++;
+}
+
+// The tick under way counts as gone, so a deadline is never early
+static DWORD deadline(DWORD ms)
+{
+    return Timer_ms + ms + 1;
+}
+
+static bool expired(DWORD dl)
+{
+    return (int32_t)(Timer_ms - dl) >= 0;
+}
+
+// Microseconds from the tick count and the SysTick down-counter. With
+// interrupts masked (async_queue(), the SSI handlers) the counter can wrap
+// before disk_timerproc() counts the tick, which would read about 1 ms back;
+// the result is held at the last one returned instead.
+static DWORD time_us(void)
+{
+    static DWORD last;
+    DWORD ms, ticks, us;
+
+    do {
+        ms = Timer_ms;
+        ticks = SysTickPeriodGet() - 1 - SysTickValueGet();
+    } while (ms != Timer_ms);
+    us = ms * 1000 + ticks / (spi_sysclk / 1000000);
+    if ((int32_t)(us - last) < 0) return last;
+    last = us;
+    return us;
+}
+
+// End the timing of the current command and start that of cmd (0xFF: none).
+// A command is timed from its selection to the next command or deselect.
+static void time_cmd(SD_DRIVE* d, uint8_t cmd)
+{
+    DWORD now = time_us();
+
+    if (d->t_cmd < 64 && now - d->t_start > d->timing.cmd_max_us[d->t_cmd])
+        d->timing.cmd_max_us[d->t_cmd] = now - d->t_start;
+    d->t_cmd = cmd;
+    d->t_start = now;
+}
+
+// A write ends at its data response (CMD24) or StopTran token (CMD25), an
+// erase at the R1 of CMD38, with the card still busy. The end of busy is
+// awaited only before the next command or in CTRL_SYNC, so the caller can
+// work in the meantime.
+static void set_busy(SD_DRIVE* d, DWORD ms)
+{
+    d->busy_until = deadline(ms);
+    d->card_busy = true;
+}
+
+static void drive_isr(SD_DRIVE* d);
+static void spi_set_clock(SD_DRIVE* d, uint32_t hz);
+
+// One handler per SSI vector
+static void ssi_isr0(void) { drive_isr(&Drives[0]); }
+#if SD_DRIVES > 1
+static void ssi_isr1(void) { drive_isr(&Drives[1]); }
+#endif
+#if SD_DRIVES > 2
+static void ssi_isr2(void) { drive_isr(&Drives[2]); }
+#endif
+#if SD_DRIVES > 3
+static void ssi_isr3(void) { drive_isr(&Drives[3]); }
+#endif
+
+static void (* const drive_isrs[SD_DRIVES])(void) = {
+    ssi_isr0,
+#if SD_DRIVES > 1
+    ssi_isr1,
+#endif
+#if SD_DRIVES > 2
+    ssi_isr2,
+#endif
+#if SD_DRIVES > 3
+    ssi_isr3,
+#endif
+};
+
+// Set the SSI frame width. The SSI must be idle: it is disabled while it is
+// reprogrammed.
+static void spi_frame(SD_DRIVE* d, uint32_t bits)
+{
+    uint32_t base = d->port->ssi_base;
+
+    if (bits == d->spi_bits) return;
+    d->spi_bits = bits;
+
+    SSIDisable(base);
+    SSIConfigSetExpClk(base, spi_sysclk, SSI_FRF_MOTO_MODE_0,
+                       SSI_MODE_MASTER, d->spi_clock, bits);
+    SSIEnable(base);
+}
 
 // ----------------------- SPI helpers -----------------------
-static void spi_init(void)
+static void spi_init(SD_DRIVE* d)
 {
-    SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOA);
-    SysCtlPeripheralEnable(SYSCTL_PERIPH_SSI0);
+    const SD_PORT* p = d->port;
+#if SD_USE_DMA
+    static bool dma_ready;
+#endif
+
+    SysCtlPeripheralEnable(p->gpio_periph);
+    SysCtlPeripheralEnable(p->ssi_periph);
 
-    GPIOPinConfigure(GPIO_PA2_SSI0CLK);
-    GPIOPinConfigure(GPIO_PA4_SSI0RX);
-    GPIOPinConfigure(GPIO_PA5_SSI0TX);
+    // PF0 (SSI1 MISO) is locked as NMI at reset
+    GPIOUnlockPin(p->gpio_base, p->rx_pin);
+    GPIOPinConfigure(p->clk_cfg);
+    GPIOPinConfigure(p->rx_cfg);
+    GPIOPinConfigure(p->tx_cfg);
 
-    GPIOPinTypeSSI(GPIO_PORTA_BASE, GPIO_PIN_2 | GPIO_PIN_4 | GPIO_PIN_5);
+    GPIOPinTypeSSI(p->gpio_base, p->clk_pin | p->rx_pin | p->tx_pin);
 
-    GPIOPinTypeGPIOOutput(CS_PORT, CS_PIN);
-    GPIOPinWrite(CS_PORT, CS_PIN, CS_PIN);
+    GPIOPinTypeGPIOOutput(p->gpio_base, p->cs_pin);
+    GPIOPinWrite(p->gpio_base, p->cs_pin, p->cs_pin);
 
     // Initial clock speed: 400kHz or less. This is necessary for all cards.
-    SSIConfigSetExpClk(SSI0_BASE, SysCtlClockGet(), SSI_FRF_MOTO_MODE_0,
-                       SSI_MODE_MASTER, 400000, 8);
+    spi_set_clock(d, 400000);
+
+#if SD_USE_DMA
+    if (!dma_ready) {
+        SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+        uDMAEnable();
+        uDMAControlBaseSet(dma_table);
+        IntEnable(INT_UDMAERR);
+        dma_ready = true;
+    }
 
-    SSIEnable(SSI0_BASE);
+    uDMAChannelAssign(p->dma_rx);
+    uDMAChannelAssign(p->dma_tx);
+    uDMAChannelAttributeDisable(DMA_CH(p->dma_rx), UDMA_ATTR_ALL);
+    uDMAChannelAttributeDisable(DMA_CH(p->dma_tx), UDMA_ATTR_ALL);
+
+    // RX outranks TX so the receive FIFO is emptied before it can overrun
+    uDMAChannelAttributeEnable(DMA_CH(p->dma_rx), UDMA_ATTR_HIGH_PRIORITY);
+#endif
+
+    // The request engine runs from the SSI interrupt
+    SSIIntRegister(p->ssi_base, drive_isrs[d - Drives]);
+    IntMasterEnable();
 }
 
-static uint8_t spi_txrx(uint8_t b)
+static uint8_t spi_txrx(SD_DRIVE* d, uint8_t b)
 {
+    uint32_t base = d->port->ssi_base;
     uint32_t r;
-    SSIDataPut(SSI0_BASE, b);
-    while(SSIBusy(SSI0_BASE));
-    SSIDataGet(SSI0_BASE, &r);
+
+    SSIDataPut(base, b);
+    while(SSIBusy(base));
+    SSIDataGet(base, &r);
     return (uint8_t)r;
 }
 
-static void cs_low(void)
+// Clock n bytes through the SSI with the TX FIFO kept topped up, so the bus
+// does not idle between bytes. At most 8 frames are in flight, which keeps
+// the RX FIFO from overrunning. A NULL rx discards what is received; a NULL
+// tx sends 0xFF.
+static void spi_block(SD_DRIVE* d, BYTE* rx, const BYTE* tx, UINT n)
+{
+    uint32_t base = d->port->ssi_base;
+    uint32_t r;
+    UINT sent = 0, rcvd = 0;
+
+    while (rcvd < n) {
+        while (sent < n && sent - rcvd < 8 &&
+               SSIDataPutNonBlocking(base, tx ? tx[sent] : 0xFF))
+            sent++;
+        while (rcvd < sent && SSIDataGetNonBlocking(base, &r)) {
+            if (rx) rx[rcvd] = (BYTE)r;
+            rcvd++;
+        }
+    }
+}
+
+static void cs_write(SD_DRIVE* d, bool high)
 {
-    GPIOPinWrite(CS_PORT, CS_PIN, 0);
+    GPIOPinWrite(d->port->gpio_base, d->port->cs_pin, high ? d->port->cs_pin : 0);
 }
 
-static void cs_high(void)
+static void cs_low(SD_DRIVE* d)
 {
-    GPIOPinWrite(CS_PORT, CS_PIN, CS_PIN);
-    spi_txrx(0xFF); // Send clock pulse to meet SD timing requirement
+    cs_write(d, false);
+}
+
+static void cs_high(SD_DRIVE* d)
+{
+    time_cmd(d, 0xFF);
+    cs_write(d, true);
+    spi_txrx(d, 0xFF); // Send clock pulse to meet SD timing requirement
+}
+
+// ----------------------- CRC -----------------------
+// CRC7 of command frames (x^7 + x^3 + 1), indexed by (crc << 1) ^ byte
+static const uint8_t crc7_table[256] = {
+    0x00, 0x09, 0x12, 0x1B, 0x24, 0x2D, 0x36, 0x3F, 0x48, 0x41, 0x5A, 0x53,
+    0x6C, 0x65, 0x7E, 0x77, 0x19, 0x10, 0x0B, 0x02, 0x3D, 0x34, 0x2F, 0x26,
+    0x51, 0x58, 0x43, 0x4A, 0x75, 0x7C, 0x67, 0x6E, 0x32, 0x3B, 0x20, 0x29,
+    0x16, 0x1F, 0x04, 0x0D, 0x7A, 0x73, 0x68, 0x61, 0x5E, 0x57, 0x4C, 0x45,
+    0x2B, 0x22, 0x39, 0x30, 0x0F, 0x06, 0x1D, 0x14, 0x63, 0x6A, 0x71, 0x78,
+    0x47, 0x4E, 0x55, 0x5C, 0x64, 0x6D, 0x76, 0x7F, 0x40, 0x49, 0x52, 0x5B,
+    0x2C, 0x25, 0x3E, 0x37, 0x08, 0x01, 0x1A, 0x13, 0x7D, 0x74, 0x6F, 0x66,
+    0x59, 0x50, 0x4B, 0x42, 0x35, 0x3C, 0x27, 0x2E, 0x11, 0x18, 0x03, 0x0A,
+    0x56, 0x5F, 0x44, 0x4D, 0x72, 0x7B, 0x60, 0x69, 0x1E, 0x17, 0x0C, 0x05,
+    0x3A, 0x33, 0x28, 0x21, 0x4F, 0x46, 0x5D, 0x54, 0x6B, 0x62, 0x79, 0x70,
+    0x07, 0x0E, 0x15, 0x1C, 0x23, 0x2A, 0x31, 0x38, 0x41, 0x48, 0x53, 0x5A,
+    0x65, 0x6C, 0x77, 0x7E, 0x09, 0x00, 0x1B, 0x12, 0x2D, 0x24, 0x3F, 0x36,
+    0x58, 0x51, 0x4A, 0x43, 0x7C, 0x75, 0x6E, 0x67, 0x10, 0x19, 0x02, 0x0B,
+    0x34, 0x3D, 0x26, 0x2F, 0x73, 0x7A, 0x61, 0x68, 0x57, 0x5E, 0x45, 0x4C,
+    0x3B, 0x32, 0x29, 0x20, 0x1F, 0x16, 0x0D, 0x04, 0x6A, 0x63, 0x78, 0x71,
+    0x4E, 0x47, 0x5C, 0x55, 0x22, 0x2B, 0x30, 0x39, 0x06, 0x0F, 0x14, 0x1D,
+    0x25, 0x2C, 0x37, 0x3E, 0x01, 0x08, 0x13, 0x1A, 0x6D, 0x64, 0x7F, 0x76,
+    0x49, 0x40, 0x5B, 0x52, 0x3C, 0x35, 0x2E, 0x27, 0x18, 0x11, 0x0A, 0x03,
+    0x74, 0x7D, 0x66, 0x6F, 0x50, 0x59, 0x42, 0x4B, 0x17, 0x1E, 0x05, 0x0C,
+    0x33, 0x3A, 0x21, 0x28, 0x5F, 0x56, 0x4D, 0x44, 0x7B, 0x72, 0x69, 0x60,
+    0x0E, 0x07, 0x1C, 0x15, 0x2A, 0x23, 0x38, 0x31, 0x46, 0x4F, 0x54, 0x5D,
+    0x62, 0x6B, 0x70, 0x79
+};
+
+// CRC-16/CCITT of data blocks (x^16 + x^12 + x^5 + 1). crc16_table[x] is the
+// CRC of byte x, crc16_table2[x] that of byte x followed by a zero byte, so
+// crc16() folds in two bytes per step with independent lookups.
+static const uint16_t crc16_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+
+static const uint16_t crc16_table2[256] = {
+    0x0000, 0x3331, 0x6662, 0x5553, 0xCCC4, 0xFFF5, 0xAAA6, 0x9997,
+    0x89A9, 0xBA98, 0xEFCB, 0xDCFA, 0x456D, 0x765C, 0x230F, 0x103E,
+    0x0373, 0x3042, 0x6511, 0x5620, 0xCFB7, 0xFC86, 0xA9D5, 0x9AE4,
+    0x8ADA, 0xB9EB, 0xECB8, 0xDF89, 0x461E, 0x752F, 0x207C, 0x134D,
+    0x06E6, 0x35D7, 0x6084, 0x53B5, 0xCA22, 0xF913, 0xAC40, 0x9F71,
+    0x8F4F, 0xBC7E, 0xE92D, 0xDA1C, 0x438B, 0x70BA, 0x25E9, 0x16D8,
+    0x0595, 0x36A4, 0x63F7, 0x50C6, 0xC951, 0xFA60, 0xAF33, 0x9C02,
+    0x8C3C, 0xBF0D, 0xEA5E, 0xD96F, 0x40F8, 0x73C9, 0x269A, 0x15AB,
+    0x0DCC, 0x3EFD, 0x6BAE, 0x589F, 0xC108, 0xF239, 0xA76A, 0x945B,
+    0x8465, 0xB754, 0xE207, 0xD136, 0x48A1, 0x7B90, 0x2EC3, 0x1DF2,
+    0x0EBF, 0x3D8E, 0x68DD, 0x5BEC, 0xC27B, 0xF14A, 0xA419, 0x9728,
+    0x8716, 0xB427, 0xE174, 0xD245, 0x4BD2, 0x78E3, 0x2DB0, 0x1E81,
+    0x0B2A, 0x381B, 0x6D48, 0x5E79, 0xC7EE, 0xF4DF, 0xA18C, 0x92BD,
+    0x8283, 0xB1B2, 0xE4E1, 0xD7D0, 0x4E47, 0x7D76, 0x2825, 0x1B14,
+    0x0859, 0x3B68, 0x6E3B, 0x5D0A, 0xC49D, 0xF7AC, 0xA2FF, 0x91CE,
+    0x81F0, 0xB2C1, 0xE792, 0xD4A3, 0x4D34, 0x7E05, 0x2B56, 0x1867,
+    0x1B98, 0x28A9, 0x7DFA, 0x4ECB, 0xD75C, 0xE46D, 0xB13E, 0x820F,
+    0x9231, 0xA100, 0xF453, 0xC762, 0x5EF5, 0x6DC4, 0x3897, 0x0BA6,
+    0x18EB, 0x2BDA, 0x7E89, 0x4DB8, 0xD42F, 0xE71E, 0xB24D, 0x817C,
+    0x9142, 0xA273, 0xF720, 0xC411, 0x5D86, 0x6EB7, 0x3BE4, 0x08D5,
+    0x1D7E, 0x2E4F, 0x7B1C, 0x482D, 0xD1BA, 0xE28B, 0xB7D8, 0x84E9,
+    0x94D7, 0xA7E6, 0xF2B5, 0xC184, 0x5813, 0x6B22, 0x3E71, 0x0D40,
+    0x1E0D, 0x2D3C, 0x786F, 0x4B5E, 0xD2C9, 0xE1F8, 0xB4AB, 0x879A,
+    0x97A4, 0xA495, 0xF1C6, 0xC2F7, 0x5B60, 0x6851, 0x3D02, 0x0E33,
+    0x1654, 0x2565, 0x7036, 0x4307, 0xDA90, 0xE9A1, 0xBCF2, 0x8FC3,
+    0x9FFD, 0xACCC, 0xF99F, 0xCAAE, 0x5339, 0x6008, 0x355B, 0x066A,
+    0x1527, 0x2616, 0x7345, 0x4074, 0xD9E3, 0xEAD2, 0xBF81, 0x8CB0,
+    0x9C8E, 0xAFBF, 0xFAEC, 0xC9DD, 0x504A, 0x637B, 0x3628, 0x0519,
+    0x10B2, 0x2383, 0x76D0, 0x45E1, 0xDC76, 0xEF47, 0xBA14, 0x8925,
+    0x991B, 0xAA2A, 0xFF79, 0xCC48, 0x55DF, 0x66EE, 0x33BD, 0x008C,
+    0x13C1, 0x20F0, 0x75A3, 0x4692, 0xDF05, 0xEC34, 0xB967, 0x8A56,
+    0x9A68, 0xA959, 0xFC0A, 0xCF3B, 0x56AC, 0x659D, 0x30CE, 0x03FF
+};
+
+// Last byte of a command frame: CRC7 and the end bit
+static uint8_t crc7(const BYTE* p, UINT n)
+{
+    uint8_t crc = 0;
+
+    while (n--) crc = crc7_table[(uint8_t)(crc << 1) ^ *p++];
+    return (uint8_t)(crc << 1) | 1;
+}
+
+static uint16_t crc16(const BYTE* p, UINT n)
+{
+    uint16_t crc = 0;
+
+    for (; n >= 2; p += 2, n -= 2)
+        crc = crc16_table2[(crc >> 8) ^ p[0]] ^ crc16_table[(crc & 0xFF) ^ p[1]];
+    if (n)
+        crc = (uint16_t)(crc << 8) ^ crc16_table[(crc >> 8) ^ p[0]];
+    return crc;
 }
 
 // ----------------------- Send CMD -----------------------
-static uint8_t send_cmd(uint8_t cmd, uint32_t arg)
+// With CS low, wait for the card to finish a deferred write
+static bool wait_ready(SD_DRIVE* d)
 {
-    uint8_t res;
-    uint8_t crc = 0x01; 
-    int n; 
+    while (d->card_busy) {
+        if (spi_txrx(d, 0xFF) == 0xFF) d->card_busy = false;
+        else if (expired(d->busy_until)) return false;
+    }
+    return true;
+}
 
-    if (cmd == 0) crc = 0x95;
-    if (cmd == 8) crc = 0x87;
+static uint8_t send_cmd(SD_DRIVE* d, uint8_t cmd, uint32_t arg)
+{
+    uint8_t res;
+    BYTE frame[7];
+    int n;
 
-    cs_high(); 
-    spi_txrx(0xFF); 
-    cs_low(); 
+    // STOP_TRANSMISSION goes out in the middle of the CMD18 stream, with
+    // the card still selected. Every other command starts a new selection.
+    time_cmd(d, cmd);
+    if (cmd != 12) {
+        cs_high(d);
+        spi_txrx(d, 0xFF);
+        cs_low(d);
+        if (!wait_ready(d)) return 0xFF;
+    }
 
-    // Command packet
-    spi_txrx(0x40 | cmd);
-    spi_txrx(arg >> 24);
-    spi_txrx(arg >> 16);
-    spi_txrx(arg >> 8);
-    spi_txrx(arg);
-    spi_txrx(crc);
+    // Command packet. The byte following STOP_TRANSMISSION is a stuff
+    // byte, not the response, so it goes out in the same burst.
+    frame[0] = 0x40 | cmd;
+    frame[1] = (BYTE)(arg >> 24);
+    frame[2] = (BYTE)(arg >> 16);
+    frame[3] = (BYTE)(arg >> 8);
+    frame[4] = (BYTE)arg;
+    frame[5] = crc7(frame, 5);
+    frame[6] = 0xFF;
+    spi_block(d, 0, frame, (cmd == 12) ? 7 : 6);
 
     // Wait for response (R1 is single byte, starts with 0)
-    for (n = 0; n < 10; n++) 
+    for (n = 0; n < 10; n++)
     {
-        res = spi_txrx(0xFF);
-        if (!(res & 0x80)) return res; 
+        res = spi_txrx(d, 0xFF);
+        if (!(res & 0x80)) return res;
     }
-    return res; 
+    return res;
 }
 
-// ----------------------- Disk I/O API -----------------------
-DSTATUS disk_initialize(BYTE drv)
+// ----------------------- Data block receive -----------------------
+// Wait for the start block token and read a short data block (CSD, CID).
+// Unlike sector data, the CRC is checked.
+static bool rcvr_datablock(SD_DRIVE* d, BYTE* buff, UINT btr)
 {
-    uint8_t type = 0; 
-    uint8_t res;
-    int i; 
+    uint8_t token;
+    uint16_t crc;
+    BYTE c[2];
+    DWORD dl = deadline(TOKEN_MS);
+
+    do {
+        token = spi_txrx(d, 0xFF);
+    } while (token == 0xFF && !expired(dl));
+    if (token != 0xFE)
+        return false;
+
+    spi_block(d, buff, 0, btr);
+    spi_block(d, c, 0, 2);
+    crc = ((uint16_t)c[0] << 8) | c[1];
+    return crc == crc16(buff, btr);
+}
+
+// Read a 16-byte register (CMD9: CSD, CMD10: CID)
+static bool read_reg(SD_DRIVE* d, uint8_t cmd, BYTE* buff)
+{
+    bool ok = (send_cmd(d, cmd, 0) == 0) && rcvr_datablock(d, buff, 16);
+
+    cs_high(d);
+    return ok;
+}
+
+// ----------------------- Clock negotiation -----------------------
+// Program the fastest SSI rate not above hz. SSIConfigSetExpClk() can round
+// its divisor below the one asked for, so pass an exact even divisor of the
+// system clock. It also clears SSE, so the SSI is enabled again afterwards.
+static void spi_set_clock(SD_DRIVE* d, uint32_t hz)
+{
+    uint32_t div;
+
+    spi_sysclk = SysCtlClockGet();
+    div = (spi_sysclk + hz - 1) / hz;
+    if (div < 2) div = 2;
+    div += div & 1;
+    d->spi_clock = spi_sysclk / div;
+
+    d->spi_bits = 0;
+    spi_frame(d, 8);
+}
+
+// Maximum data rate in the CSD TRAN_SPEED field (csd[3]), in Hz
+static uint32_t csd_tran_speed(const BYTE* csd)
+{
+    static const uint8_t mult[16] = {    // Time value x10
+        0, 10, 12, 13, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 70, 80
+    };
+    static const uint32_t unit[4] = {    // Rate unit / 10
+        10000, 100000, 1000000, 10000000
+    };
+
+    if ((csd[3] & 7) > 3) return 0;
+    return unit[csd[3] & 7] * mult[(csd[3] >> 3) & 0x0F];
+}
 
-    if (drv != 0) return STA_NOINIT;
+// Test read at the current clock: the CSD must come back intact and equal to
+// the copy read at 400 kHz, several times over.
+static bool probe_clock(SD_DRIVE* d, const BYTE* ref)
+{
+    BYTE csd[16];
+    int n, i;
 
-    spi_init();
+    for (n = 0; n < 8; n++) {
+        if (!read_reg(d, 9, csd)) return false;
+        for (i = 0; i < 16; i++)
+            if (csd[i] != ref[i]) return false;
+    }
+    return true;
+}
 
-    for (i = 0; i < 10; i++) spi_txrx(0xFF); 
+// Raise the clock to what the card (TRAN_SPEED), the part (SD_MAX_CLOCK) and
+// the MMC_SET_MAX_CLK cap allow, halving it while the test read fails. The
+// CSD read at 400 kHz is kept in card.csd; false if it could not be read.
+static bool spi_negotiate(SD_DRIVE* d)
+{
+    const BYTE* ref = d->card.csd;
+    uint32_t hz;
 
-    if (send_cmd(0, 0) != 1) { 
-        cs_high();
-        return STA_NOINIT; 
+    if (!read_reg(d, 9, d->card.csd)) return false;
+
+    hz = csd_tran_speed(ref);
+    if (!hz || hz > SD_MAX_CLOCK) hz = SD_MAX_CLOCK;
+    if (d->clk_cap && hz > d->clk_cap) hz = d->clk_cap;
+
+    while (hz > 400000) {
+        spi_set_clock(d, hz);
+        if (probe_clock(d, ref)) return true;
+        hz = d->spi_clock / 2;
     }
+    spi_set_clock(d, 400000);
+    return true;
+}
 
-    if (send_cmd(8, 0x1AA) == 1) 
-    {
-        spi_txrx(0xFF); 
-        uint8_t vh = spi_txrx(0xFF); 
-        uint8_t chk = spi_txrx(0xFF); 
-        spi_txrx(0xFF); 
-        spi_txrx(0xFF);
-
-        if (vh == 0x01 && chk == 0xAA) {
-            type = 1; // SDv2/SDHC compatible
-        }
+// ----------------------- High Speed -----------------------
+// CMD6 SWITCH_FUNC on function group 1 (access mode), every other group left
+// as it is (0xF). set=false only checks what the switch would do. The 64-byte
+// switch status goes to st.
+static bool switch_func(SD_DRIVE* d, bool set, uint8_t fn, BYTE* st)
+{
+    DWORD arg = (set ? 0x80000000UL : 0) | 0x00FFFFF0UL | fn;
+    bool ok = (send_cmd(d, 6, arg) == 0) && rcvr_datablock(d, st, 64);
+
+    cs_high(d);
+    return ok;
+}
+
+// Put an SD card into High Speed mode (group 1, function 1) if it supports
+// it. Both the check and the switch must report function 1 selected in the
+// status (bits 379:376); the card then shows 50 MHz in TRAN_SPEED. SDv1.0
+// cards reject CMD6 as an illegal command and stay in default speed.
+// The status block is static: disk_initialize() already runs deep on the
+// 512-byte stack, and the SSI interrupt nests on top of it.
+static bool switch_high_speed(SD_DRIVE* d)
+{
+    static BYTE st[64];
+
+    if (!(d->card.type & CT_SDC)) return false;
+
+    // Function group 1 support bits 415:400: bit 401 is High Speed
+    if (!switch_func(d, false, 1, st) || !(st[13] & 0x02) || (st[16] & 0x0F) != 1)
+        return false;
+    if (!switch_func(d, true, 1, st) || (st[16] & 0x0F) != 1)
+        return false;
+
+    // The new timing applies within 8 clocks of the status block
+    spi_txrx(d, 0xFF);
+    return true;
+}
+
+// ----------------------- Card info -----------------------
+// Capacity in sectors from the CSD (version 1.0 for SDSC and MMC, 2.0 for
+// SDHC/SDXC)
+static DWORD csd_sectors(const BYTE* csd)
+{
+    DWORD csize;
+    uint8_t n;
+
+    if ((csd[0] >> 6) == 1) {
+        csize = ((DWORD)(csd[7] & 0x3F) << 16) | ((DWORD)csd[8] << 8) | csd[9];
+        return (csize + 1) << 10;
     }
+    n = (csd[5] & 15) + ((csd[10] & 128) >> 7) + ((csd[9] & 3) << 1) + 2;
+    csize = (csd[8] >> 6) + ((DWORD)csd[7] << 2) + ((DWORD)(csd[6] & 3) << 10) + 1;
+    return csize << (n - 9);
+}
 
-    // ACMD41 loop
-    for (i = 0; i < 200000; i++) 
-    {
-        res = send_cmd(55, 0);
-        if (res > 1) { 
-            type = 0; 
-            break; 
+// Erase block size in sectors: the AU size of the SD Status for SDv2, the
+// CSD erase fields for SDv1 and MMC
+static DWORD erase_sectors(const CARD_INFO* card)
+{
+    static const uint16_t au[16] = {    // AU_SIZE, in 16 KB units
+        0, 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 768, 1024, 1536, 2048, 4096
+    };
+    const BYTE* csd = card->csd;
+
+    if (card->type & CT_SD2)
+        return au[card->sdstat[10] >> 4] * 32UL;
+    if (card->type & CT_SD1)
+        return ((((csd[10] & 63) << 1) | (csd[11] >> 7)) + 1UL) << ((csd[13] >> 6) - 1);
+    return (((csd[10] & 124) >> 2) + 1UL) *
+           ((((csd[11] & 3) << 3) | (csd[11] >> 5)) + 1);
+}
+
+// Read the CID and, on SD cards, the SD Status; the CSD and OCR were read
+// during init
+static bool read_card_info(SD_DRIVE* d)
+{
+    CARD_INFO* card = &d->card;
+
+    if (!read_reg(d, 10, card->cid)) return false;
+
+    if (card->type & CT_SDC) {
+        // ACMD13 answers with R2: R1 and a second status byte
+        bool ok = send_cmd(d, 55, 0) <= 1 && send_cmd(d, 13, 0) == 0;
+
+        if (ok) {
+            spi_txrx(d, 0xFF);
+            ok = rcvr_datablock(d, card->sdstat, 64);
         }
+        cs_high(d);
+        if (!ok) return false;
+    }
+
+    card->sectors = csd_sectors(card->csd);
+    card->au_sectors = erase_sectors(card);
+    return true;
+}
 
-        uint32_t arg = (type == 1) ? (1UL << 30) : 0;
-        res = send_cmd(41, arg);
-        
-        if (res == 0) { 
-            // If SDv2+, read OCR (R3) to check CCS (Card Capacity Status)
-            if (type == 1) {
-                uint8_t r3[4];
-                if (send_cmd(58, 0) == 0) {
-                    int n;
-                    for (n = 0; n < 4; n++) r3[n] = spi_txrx(0xFF);
-                    // CCS bit check (r3[0] & 0x40) is important, but not critical for initial read/write
-                }
+// ----------------------- Background exchange -----------------------
+// One exchange clocks n bytes through the SSI without the CPU: with uDMA when
+// SD_USE_DMA is 1, otherwise by topping up the FIFOs from the SSI interrupt.
+// A NULL rx discards the received bytes; a NULL tx sends 0xFF. rx may equal
+// tx. When the last byte has been received, drive_isr() calls async_step().
+#if !SD_USE_DMA
+#define FIFO_IRQ_MAX 32         // Longer exchanges run as one burst
+#endif
+
+static void async_step(SD_DRIVE* d);
+
+#if SD_WIDE_FRAMES && !SD_USE_DMA
+// spi_block() in 16-bit frames, for even n. Each frame carries two bytes,
+// first byte in the upper half as it goes out MSB first.
+static void spi_block16(SD_DRIVE* d, BYTE* rx, const BYTE* tx, UINT n)
+{
+    uint32_t base = d->port->ssi_base;
+    uint32_t r;
+    UINT sent = 0, rcvd = 0;
+
+    while (rcvd < n) {
+        while (sent < n && sent - rcvd < 16 &&
+               SSIDataPutNonBlocking(base,
+                   tx ? ((uint32_t)tx[sent] << 8) | tx[sent + 1] : 0xFFFF))
+            sent += 2;
+        while (rcvd < sent && SSIDataGetNonBlocking(base, &r)) {
+            if (rx) {
+                rx[rcvd] = (BYTE)(r >> 8);
+                rx[rcvd + 1] = (BYTE)r;
             }
-            
-            // --- CRITICAL FIX 1: REDUCE DATA TRANSFER SPEED ---
-            // Set speed to ~500 kHz (80 MHz / 160) for maximum stability during reads/writes.
-            SSIConfigSetExpClk(SSI0_BASE, SysCtlClockGet(), SSI_FRF_MOTO_MODE_0,
-                               SSI_MODE_MASTER, SysCtlClockGet()/160, 8); 
-
-            Stat &= ~STA_NOINIT;
-            cs_high();
-            return Stat;
+            rcvd += 2;
         }
     }
+}
+#endif
+
+#if SD_WIDE_FRAMES && SD_USE_DMA
+// The uDMA stores 16-bit frames little-endian; put the bytes back in wire
+// order.
+static void swap16(BYTE* p, UINT n)
+{
+    BYTE t;
+
+    for (; n >= 2; p += 2, n -= 2) {
+        t = p[0];
+        p[0] = p[1];
+        p[1] = t;
+    }
+}
+#endif
+
+#if !SD_USE_DMA
+// Move what the FIFOs allow. At most 8 frames are in flight, so the RX FIFO
+// cannot overrun however late the interrupt is serviced.
+static void fifo_pump(SD_DRIVE* d)
+{
+    uint32_t base = d->port->ssi_base;
+    uint32_t r;
+
+    while (d->x_rcvd < d->x_sent && SSIDataGetNonBlocking(base, &r)) {
+        if (d->x_rx) d->x_rx[d->x_rcvd] = (BYTE)r;
+        d->x_rcvd++;
+    }
+    while (d->x_sent < d->x_len && d->x_sent - d->x_rcvd < 8) {
+        if (!SSIDataPutNonBlocking(base, d->x_tx ? d->x_tx[d->x_sent] : 0xFF))
+            break;
+        d->x_sent++;
+    }
+}
+#endif
+
+static void xfer_run(SD_DRIVE* d, BYTE* rx, const BYTE* tx, UINT n, uint32_t bits)
+{
+    uint32_t base = d->port->ssi_base;
+    uint32_t junk;
+#if SD_USE_DMA
+    uint32_t rxch = DMA_CH(d->port->dma_rx), txch = DMA_CH(d->port->dma_tx);
+    bool wide = (bits > 8);
+    uint32_t size = wide ? UDMA_SIZE_16 : UDMA_SIZE_8;
+#endif
 
-    // Fallback attempt for MMC/Old SDv1 
-    if (type == 0) {
-        if (send_cmd(1, 0) == 0) {
-             Stat &= ~STA_NOINIT;
-             cs_high();
-             return Stat;
+    // Drop stale frames so received bytes line up with transmitted ones
+    while (SSIDataGetNonBlocking(base, &junk));
+    spi_frame(d, bits);
+
+    d->x_rx = rx;
+    d->x_tx = tx;
+    d->x_len = n;
+    d->x_active = true;
+
+#if SD_USE_DMA
+    uDMAChannelControlSet(rxch | UDMA_PRI_SELECT,
+                          size | UDMA_SRC_INC_NONE | UDMA_ARB_4 |
+                          (!rx ? UDMA_DST_INC_NONE :
+                           wide ? UDMA_DST_INC_16 : UDMA_DST_INC_8));
+    uDMAChannelTransferSet(rxch | UDMA_PRI_SELECT,
+                           UDMA_MODE_BASIC, (void*)(uintptr_t)(base + SSI_O_DR),
+                           rx ? (void*)rx : (void*)&dma_sink, wide ? n / 2 : n);
+
+    uDMAChannelControlSet(txch | UDMA_PRI_SELECT,
+                          size | UDMA_DST_INC_NONE | UDMA_ARB_4 |
+                          (!tx ? UDMA_SRC_INC_NONE :
+                           wide ? UDMA_SRC_INC_16 : UDMA_SRC_INC_8));
+    uDMAChannelTransferSet(txch | UDMA_PRI_SELECT,
+                           UDMA_MODE_BASIC,
+                           tx ? (void*)tx : (void*)&dma_ones,
+                           (void*)(uintptr_t)(base + SSI_O_DR), wide ? n / 2 : n);
+
+    uDMAChannelEnable(rxch);
+    uDMAChannelEnable(txch);
+    SSIDMAEnable(base, SSI_DMA_RX | SSI_DMA_TX);
+#else
+    if (n > FIFO_IRQ_MAX) {
+        // A data block keeps the CPU busy either way; move it in one
+        // pipelined burst and let the SSI handler carry on from there.
+#if SD_WIDE_FRAMES
+        if (bits > 8) spi_block16(d, rx, tx, n);
+        else
+#endif
+        spi_block(d, rx, tx, n);
+        d->x_sent = d->x_rcvd = n;
+        IntPendSet(d->port->ssi_int);
+        return;
+    }
+    d->x_sent = d->x_rcvd = 0;
+    SSIIntClear(base, SSI_RXTO);
+    SSIIntEnable(base, SSI_RXFF | SSI_RXTO);
+    fifo_pump(d);
+#endif
+}
+
+static void xfer_start(SD_DRIVE* d, BYTE* rx, const BYTE* tx, UINT n)
+{
+    xfer_run(d, rx, tx, n, 8);
+}
+
+// Exchange block data, in 16-bit frames where the buffer allows it
+static void xfer_data(SD_DRIVE* d, BYTE* rx, const BYTE* tx, UINT n)
+{
+#if SD_WIDE_FRAMES && SD_USE_DMA
+    // Received frames are byte-swapped in place afterwards, which needs an
+    // even address. Transmit buffers are the caller's and stay 8-bit.
+    if (!tx && !(n & 1) && !((uintptr_t)rx & 1)) {
+        xfer_run(d, rx, tx, n, 16);
+        return;
+    }
+#elif SD_WIDE_FRAMES
+    if (!(n & 1) && n > FIFO_IRQ_MAX) {
+        xfer_run(d, rx, tx, n, 16);
+        return;
+    }
+#endif
+    xfer_run(d, rx, tx, n, 8);
+}
+
+static void drive_isr(SD_DRIVE* d)
+{
+    uint32_t base = d->port->ssi_base;
+
+#if SD_USE_DMA
+    // uDMA completion is signalled on the SSI vector. TX finishes first;
+    // the exchange is over when RX has stored its last byte.
+    uDMAIntClear((1 << DMA_CH(d->port->dma_rx)) | (1 << DMA_CH(d->port->dma_tx)));
+    if (!d->x_active || uDMAChannelIsEnabled(DMA_CH(d->port->dma_rx))) return;
+    SSIDMADisable(base, SSI_DMA_RX | SSI_DMA_TX);
+#else
+    SSIIntClear(base, SSI_RXTO);
+    if (!d->x_active) return;
+    fifo_pump(d);
+    if (d->x_rcvd < d->x_len) return;
+    SSIIntDisable(base, SSI_RXFF | SSI_RXTO);
+#endif
+    d->x_active = false;
+#if SD_WIDE_FRAMES && SD_USE_DMA
+    if (d->spi_bits > 8 && d->x_rx) {
+        BYTE* p = d->x_rx;
+        UINT n = d->x_len;
+
+        // Start the next exchange first so the swap overlaps it
+        async_step(d);
+        swap16(p, n);
+        return;
+    }
+#endif
+    async_step(d);
+}
+
+// uDMA bus error interrupt (vector table entry "uDMA Error"). The faulting
+// channel has stopped; the error status does not say which, so every drive
+// with an exchange under way ends it through its SSI handler.
+void uDMAErrorHandler(void)
+{
+    int i;
+
+    if (uDMAErrorStatusGet()) {
+        uDMAErrorStatusClear();
+        for (i = 0; i < SD_DRIVES; i++) {
+            if (!Drives[i].x_active) continue;
+            Drives[i].dma_fault = true;
+            IntPendSet(Drives[i].port->ssi_int);
         }
     }
+}
+
+// ----------------------- Scheduler -----------------------
+// Requests wait in a_queue in order of arrival. A metadata request, posted
+// with disk_read_meta()/disk_write_meta(), starts ahead of older data
+// requests, as its caller is waiting on it. A write that continues where
+// the running CMD25 has got to is chained onto it instead of starting a new
+// command.
+
+// Take a request off the queue; later ones move down a slot
+static void queue_remove(SD_DRIVE* d, DISK_REQ* r)
+{
+    DISK_REQ* end = d->a_queue + d->a_count;
 
-    cs_high();
-    return STA_NOINIT; 
+    for (; r + 1 < end; r++) *r = r[1];
+    d->a_count--;
+    d->qstats.depth = d->a_count;
 }
 
-DSTATUS disk_status(BYTE drv)
+// The oldest metadata request, else the oldest request
+static DISK_REQ* queue_pick(SD_DRIVE* d)
 {
-    if (drv != 0) return STA_NOINIT;
-    return Stat;
+    DISK_REQ* q;
+
+    for (q = d->a_queue; q < d->a_queue + d->a_count; q++)
+        if (q->cls == DISK_META) return q;
+    return d->a_queue;
 }
 
-DRESULT disk_read(BYTE drv, BYTE* buff, DWORD sector, BYTE count)
+// A queued write at sector that can be chained onto the running write. None
+// while a metadata request is waiting: that one goes first.
+static DISK_REQ* queue_next_write(SD_DRIVE* d, DWORD sector)
+{
+    DISK_REQ* q;
+    DISK_REQ* hit = 0;
+
+    for (q = d->a_queue; q < d->a_queue + d->a_count; q++) {
+        if (q == d->a_req) continue;
+        if (!hit && q->op == REQ_WRITE && q->sector == sector) hit = q;
+        else if (q->cls == DISK_META) return 0;
+    }
+    return hit;
+}
+
+// Blocks the running write and the queued writes that would chain onto it
+// will send: the pre-erase count for ACMD23
+static DWORD queue_write_run(SD_DRIVE* d)
+{
+    DISK_REQ* q = d->a_req;
+    DWORD sector = q->sector, n = 0;
+
+    do {
+        n += q->count;
+        sector += q->count;
+    } while ((q = queue_next_write(d, sector)) != 0);
+    return n;
+}
+
+// Time r spent queued
+static void queue_waited(SD_DRIVE* d, const DISK_REQ* r)
+{
+    DWORD us = time_us() - r->queued_us;
+
+    d->qstats.wait_us[r->cls] += us;
+    if (us > d->qstats.wait_max_us[r->cls]) d->qstats.wait_max_us[r->cls] = us;
+}
+
+// ----------------------- Request engine -----------------------
+// Queued requests run one at a time per drive. Each state starts one
+// exchange; async_step() looks at what came back and starts the next. Polls
+// clock POLL_LEN bytes at a time, and bytes that arrive after a token in the
+// same exchange are kept, so no response is lost between exchanges.
+#define POLL_LEN    16
+
+// Send a_cmd with CS low: the frame, the stuff byte after CMD12, R1 polls
+static void async_cmd(SD_DRIVE* d)
 {
-    BYTE c; 
-    int i; 
-    int n; 
-    uint32_t timeout = 0;
+    BYTE* b = d->a_buf;
+    uint8_t n;
+
+    b[0] = 0x40 | d->a_cmd;
+    b[1] = (BYTE)(d->a_arg >> 24);
+    b[2] = (BYTE)(d->a_arg >> 16);
+    b[3] = (BYTE)(d->a_arg >> 8);
+    b[4] = (BYTE)d->a_arg;
+    b[5] = crc7(b, 5);
+    for (n = 6; n < 17; n++) b[n] = 0xFF;
+
+    d->a_state = AS_CMD;
+    xfer_start(d, b, b, d->a_cmd == 12 ? 17 : 16);
+}
 
-    if (drv != 0 || !count) return RES_PARERR;
-    if (Stat & STA_NOINIT) return RES_NOTRDY;
+// CMD12 goes out in the middle of the CMD18 stream, with the card still
+// selected, as in send_cmd()
+static void async_select(SD_DRIVE* d, uint8_t cmd, DWORD arg)
+{
+    d->a_cmd = cmd;
+    d->a_arg = arg;
+    time_cmd(d, cmd);
+    if (cmd == 12) {
+        async_cmd(d);
+        return;
+    }
+    cs_write(d, true);
+    d->a_state = AS_SELECT;
+    xfer_start(d, 0, 0, 2);
+}
+
+static void async_deselect(SD_DRIVE* d)
+{
+    time_cmd(d, 0xFF);
+    cs_write(d, true);
+    d->a_state = AS_DESELECT;
+    xfer_start(d, 0, 0, 1);
+}
 
-    for (c = 0; c < count; c++)
+static void async_poll(SD_DRIVE* d, ASTATE st)
+{
+    d->a_state = st;
+    xfer_start(d, d->a_buf, 0, POLL_LEN);
+}
+
+// True if the card released DO (read 0xFF) anywhere in the last poll
+static bool async_ready(SD_DRIVE* d)
+{
+    UINT i;
+
+    for (i = 0; i < d->x_len; i++)
+        if (d->a_buf[i] == 0xFF) return true;
+    return false;
+}
+
+// Abandon a read. A CMD18 stream still has to be stopped.
+static void async_read_fail(SD_DRIVE* d)
+{
+    d->a_res = RES_ERROR;
+    if (d->a_cmd == 18) async_select(d, 12, 0);
+    else async_deselect(d);
+}
+
+// Receive the read block from a_done on. 16-bit frames need an even length,
+// and with uDMA an even address: an odd first byte is received on its own and
+// an odd last byte along with the CRC.
+static void async_rdata(SD_DRIVE* d)
+{
+    BYTE* p = d->a_req->buff + d->a_done;
+    UINT n = 512 - d->a_done;
+
+#if SD_WIDE_FRAMES
+    if (SD_USE_DMA && n > 1 && ((uintptr_t)p & 1)) n = 1;
+    else n &= ~1;
+#endif
+    if (n) {
+        d->a_state = AS_RDATA;
+        d->a_done += n;
+        xfer_data(d, p, 0, n);
+        return;
+    }
+
+    d->a_state = AS_RCRC;
+    xfer_start(d, d->a_buf, 0, 512 - d->a_done + 2);
+}
+
+// Look for the start block token in a_buf[from..x_len). Data bytes that
+// followed it in the same exchange go straight into the buffer.
+static void async_token(SD_DRIVE* d, UINT from)
+{
+    UINT i, n;
+
+    for (i = from; i < d->x_len && d->a_buf[i] == 0xFF; i++);
+    if (i == d->x_len) {
+        if (expired(d->a_until)) async_read_fail(d);
+        else async_poll(d, AS_TOKEN);
+        return;
+    }
+    if (d->a_buf[i] != 0xFE) {
+        async_read_fail(d);
+        return;
+    }
+
+    for (n = 0, i++; i < d->x_len; n++, i++)
+        d->a_req->buff[n] = d->a_buf[i];
+
+    d->a_done = n;
+    async_rdata(d);
+}
+
+// After a write block: wait for the card before the next block or the
+// StopTran token of CMD25. CMD24 ends here, with the card programming.
+static void async_write_next(SD_DRIVE* d)
+{
+    if (d->a_cmd != 25) {
+        set_busy(d, BUSY_MS);
+        async_deselect(d);
+        return;
+    }
+    d->a_until = deadline(BUSY_MS);
+    async_poll(d, AS_WREADY);
+}
+
+// Data address of a sector: SDSC and MMC take byte addresses
+static DWORD card_addr(SD_DRIVE* d, DWORD sector)
+{
+    return (d->card.type & CT_BLOCK) ? sector : sector * 512;
+}
+
+// Response of the command of the current stage
+static void async_r1(SD_DRIVE* d, uint8_t r1, UINT next)
+{
+    switch (d->a_cmd)
     {
-        if (send_cmd(17, sector + c) != 0) 
-            return RES_ERROR;
-
-        uint8_t token;
-        // Wait for start block token (0xFE) with a generous timeout
-        timeout = 0;
-        for(n = 0; n < 20000; n++) { // Increased timeout for read token
-            token = spi_txrx(0xFF);
-            if (token != 0xFF) break;
+        case 55:    // ACMD23 pre-erase hint; results ignored as before
+            async_select(d, 23, queue_write_run(d));
+            break;
+        case 23:
+            async_select(d, 25, card_addr(d, d->a_req->sector));
+            break;
+        case 17:
+        case 18:
+            if (r1) { d->a_res = RES_ERROR; async_deselect(d); break; }
+            d->a_until = deadline(TOKEN_MS);
+            async_token(d, next);
+            break;
+        case 24:
+        case 25:
+            if (r1) { d->a_res = RES_ERROR; async_deselect(d); break; }
+            d->a_until = deadline(BUSY_MS);
+            async_poll(d, AS_WREADY);
+            break;
+        case 32:    // ERASE_WR_BLK_START
+        case 33:    // ERASE_WR_BLK_END
+            if (r1) { d->a_res = RES_ERROR; async_deselect(d); break; }
+            if (d->a_cmd == 32)
+                async_select(d, 33, card_addr(d, ((DWORD*)d->a_req->buff)[1]));
+            else
+                async_select(d, 38, 0);
+            break;
+        case 38:    // ERASE is R1b; the busy is left to the next command
+            if (r1) { d->a_res = RES_ERROR; async_deselect(d); break; }
+            d->a_req->count = 0;
+            set_busy(d, ERASE_MS);
+            async_deselect(d);
+            break;
+        default:    // 12: STOP_TRANSMISSION is R1b
+            d->a_until = deadline(BUSY_MS);
+            async_poll(d, AS_BUSY);
+            break;
+    }
+}
+
+// Start r, from the sector it has got to.
+//
+// Sequential reads share one READ_MULTIPLE_BLOCK stream: a read that ends
+// where the previous one did, or spans several blocks, uses CMD18 and leaves
+// it running with CS low. A read at the sector the stream delivers next just
+// waits for the next token, so single-sector reads of a file come off the
+// stream without a command each. Any other request stops the stream with
+// CMD12 first.
+static void async_begin(SD_DRIVE* d, DISK_REQ* r)
+{
+    DWORD addr;
+
+    d->a_req = r;
+    d->a_res = RES_OK;
+    d->a_first = r->sector;
+
+    if (d->s_open) {
+        d->s_open = false;
+        if (r->op == REQ_READ && r->sector == d->s_next) {
+            d->a_cmd = 18;
+            time_cmd(d, 18);
+            d->a_until = deadline(TOKEN_MS);
+            async_poll(d, AS_TOKEN);
+        } else {
+            d->a_closing = true;
+            async_select(d, 12, 0);
         }
-        
-        if (token != 0xFE)
-            return RES_ERROR;
+        return;
+    }
 
-        for (i = 0; i < 512; i++)
-            buff[c * 512 + i] = spi_txrx(0xFF);
+    if (r->op == REQ_ERASE) {
+        async_select(d, 32, card_addr(d, ((DWORD*)r->buff)[0]));
+        return;
+    }
 
-        spi_txrx(0xFF); spi_txrx(0xFF);
-        cs_high();
+    // A single block write uses CMD25 too when a write is queued behind it
+    addr = card_addr(d, r->sector);
+    if (r->op == REQ_READ)
+        async_select(d, (r->count > 1 || r->sector == d->r_next) ? 18 : 17, addr);
+    else if (r->count == 1 && !queue_next_write(d, r->sector + 1))
+        async_select(d, 24, addr);
+    else if (d->card.type & CT_SDC)
+        async_select(d, 55, 0);     // ACMD23 first
+    else
+        async_select(d, 25, addr);
+}
+
+// Start the next request if the engine is idle
+static void async_start(SD_DRIVE* d)
+{
+    DISK_REQ* r;
+
+    if (d->a_state != AS_IDLE || !d->a_count) return;
+
+    r = queue_pick(d);
+    if (r != d->a_queue) d->qstats.bypassed++;
+    queue_waited(d, r);
+    async_begin(d, r);
+}
+
+static void async_finish(SD_DRIVE* d)
+{
+    DISK_REQ* r = d->a_req;
+    DISK_CALLBACK cb = r->cb;
+    void* arg = r->arg;
+    DRESULT res = (d->a_res == RES_OK && r->count) ? RES_ERROR : d->a_res;
+
+    // Start over from the block that failed. The count of retries restarts
+    // when the last attempt got some blocks through.
+    if (d->a_res != RES_OK && r->count) {
+        if (r->sector != d->a_first) d->a_tries = 0;
+        if (d->a_tries < SD_RETRIES) {
+            d->a_tries++;
+            d->a_state = AS_IDLE;
+            async_begin(d, r);
+            return;
+        }
     }
+    d->a_tries = 0;
+
+    // Free the slot before the callback so it can queue the next request
+    queue_remove(d, r);
+    d->a_state = AS_IDLE;
 
+    if (cb) cb(res, arg);
+    async_start(d);
+}
+
+// The running write has sent its last block and the CMD25 is still open:
+// complete it and carry on with the queued write at the next sector, if any
+static bool async_chain(SD_DRIVE* d)
+{
+    DISK_REQ* r = d->a_req;
+    DISK_REQ* q = queue_next_write(d, r->sector);
+    DISK_CALLBACK cb = r->cb;
+    void* arg = r->arg;
+
+    if (!q) return false;
+
+    if (q > r) q--;             // Moves down when r is removed
+    queue_remove(d, r);
+    d->a_req = q;
+    d->a_first = q->sector;
+    d->a_tries = 0;
+    d->qstats.merged++;
+    queue_waited(d, q);
+
+    if (cb) cb(RES_OK, arg);
+    return true;
+}
+
+// Called when an exchange has finished
+static void async_step(SD_DRIVE* d)
+{
+    DISK_REQ* r = d->a_req;
+    BYTE* b = d->a_buf;
+    UINT i;
+    BYTE* p;
+    uint16_t crc;
+
+    if (d->dma_fault && d->a_state != AS_DESELECT) {
+        d->dma_fault = false;
+        d->a_res = RES_ERROR;
+        async_deselect(d);
+        return;
+    }
+
+    switch (d->a_state)
+    {
+        case AS_SELECT:
+            cs_low(d);
+            if (d->card_busy) {
+                async_poll(d, AS_READY);
+                break;
+            }
+            async_cmd(d);
+            break;
+
+        case AS_READY:
+            if (!async_ready(d)) {
+                if (expired(d->busy_until)) { d->a_res = RES_ERROR; async_deselect(d); }
+                else async_poll(d, AS_READY);
+                break;
+            }
+            d->card_busy = false;
+            async_cmd(d);
+            break;
+
+        case AS_CMD:
+            for (i = (d->a_cmd == 12) ? 7 : 6; i < d->x_len && (b[i] & 0x80); i++);
+            async_r1(d, i < d->x_len ? b[i] : 0xFF, i + 1);
+            break;
+
+        case AS_TOKEN:
+            if (d->a_res != RES_OK) async_read_fail(d);     // CRC of last block
+            else async_token(d, 0);
+            break;
+
+        case AS_RDATA:
+            async_rdata(d);
+            break;
+
+        case AS_RCRC:
+            if (d->x_len > 2) r->buff[511] = b[0];
+            p = r->buff;
+            crc = ((uint16_t)b[d->x_len - 2] << 8) | b[d->x_len - 1];
+            r->buff += 512;
+            r->sector++;
+            r->count--;
+            if (!r->count) d->r_next = r->sector;
+
+            // Last block of a CMD18 read: leave the stream open unless it
+            // would run off the end of the card
+            if (!r->count && d->a_cmd == 18 && r->sector < d->card.sectors &&
+                (!SD_USE_CRC || crc16(p, 512) == crc)) {
+                d->s_open = true;
+                d->s_next = r->sector;
+                time_cmd(d, 0xFF);
+                async_finish(d);
+                break;
+            }
+
+            if (r->count) {
+                d->a_until = deadline(TOKEN_MS);
+                async_poll(d, AS_TOKEN);
+            } else if (d->a_cmd == 18) {
+                async_select(d, 12, 0);
+            } else {
+                async_deselect(d);
+            }
+            // Checked while the next exchange runs; a bad block is retried
+            if (SD_USE_CRC && crc16(p, 512) != crc) {
+                r->buff = p;
+                r->sector--;
+                r->count++;
+                d->a_res = RES_ERROR;
+            }
+            break;
+
+        case AS_WREADY:
+            if (!async_ready(d)) {
+                if (expired(d->a_until)) { d->a_res = RES_ERROR; async_deselect(d); }
+                else async_poll(d, AS_WREADY);
+                break;
+            }
+            if (!r->count && d->a_res == RES_OK && d->a_cmd == 25 && async_chain(d))
+                r = d->a_req;
+            if (!r->count || d->a_res != RES_OK) {
+                // StopTran token and the stuff byte after it
+                b[0] = 0xFD;
+                b[1] = 0xFF;
+                d->a_state = AS_STOP;
+                xfer_start(d, 0, b, 2);
+                break;
+            }
+            b[0] = (d->a_cmd == 25) ? 0xFC : 0xFE;
+            d->a_state = AS_WTOKEN;
+            xfer_start(d, 0, b, 1);
+            break;
+
+        case AS_WTOKEN:
+            d->a_state = AS_WDATA;
+            xfer_data(d, 0, r->buff, 512);
+#if SD_USE_CRC
+            d->a_crc = crc16(r->buff, 512);     // While the block goes out
+#endif
+            break;
+
+        case AS_WDATA:
+            // Data CRC, then the data response
+            b[0] = (BYTE)(d->a_crc >> 8);
+            b[1] = (BYTE)d->a_crc;
+            b[2] = 0xFF;
+            d->a_state = AS_WRESP;
+            xfer_start(d, b, b, 3);
+            break;
+
+        case AS_WRESP:
+            if ((b[2] & 0x1F) != 0x05) {
+                d->a_res = RES_ERROR;   // Stops a CMD25 stream at this block
+            } else {
+                r->buff += 512;
+                r->sector++;
+                r->count--;
+            }
+            async_write_next(d);
+            break;
+
+        case AS_STOP:
+            set_busy(d, BUSY_MS);
+            async_deselect(d);
+            break;
+
+        case AS_BUSY:
+            if (!async_ready(d)) {
+                if (expired(d->a_until)) { d->a_res = RES_ERROR; async_deselect(d); }
+                else async_poll(d, AS_BUSY);
+                break;
+            }
+            async_deselect(d);
+            break;
+
+        case AS_DESELECT:
+            if (d->a_closing) {
+                // Stream closed; now run the request itself
+                d->a_closing = false;
+                d->a_state = AS_IDLE;
+                async_start(d);
+                break;
+            }
+            async_finish(d);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Queue a request. With wait set, sleep until a slot is free instead of
+// failing when the queue is full.
+static DRESULT async_queue(SD_DRIVE* d, BYTE* buff, DWORD sector, BYTE count,
+                           REQ_OP op, BYTE cls, DISK_CALLBACK cb, void* arg,
+                           bool wait)
+{
+    DISK_REQ* r;
+    bool masked;
+
+    if (!count) return RES_PARERR;
+    if (d->stat & STA_NOINIT) return RES_NOTRDY;
+
+    if (wait) WAIT_FOR(d->a_count < SD_QUEUE_LEN);
+
+    masked = IntMasterDisable();
+    if (d->a_count == SD_QUEUE_LEN) {
+        if (!masked) IntMasterEnable();
+        return RES_NOTRDY;
+    }
+
+    r = &d->a_queue[d->a_count];
+    r->buff = buff;
+    r->sector = sector;
+    r->count = count;
+    r->op = op;
+    r->cls = cls;
+    r->queued_us = time_us();
+    r->cb = cb;
+    r->arg = arg;
+    d->a_count++;
+
+    d->qstats.queued[cls]++;
+    if (op == REQ_WRITE) d->qstats.writes[cls]++;
+    d->qstats.depth = d->a_count;
+    if (d->a_count > d->qstats.depth_max) d->qstats.depth_max = d->a_count;
+    async_start(d);
+
+    if (!masked) IntMasterEnable();
     return RES_OK;
 }
 
-DRESULT disk_write(BYTE drv, const BYTE* buff, DWORD sector, BYTE count)
+// Completion of a blocking disk_read()/disk_write()
+typedef struct {
+    volatile bool    done;
+    volatile DRESULT res;
+} SYNC_REQ;
+
+static void sync_done(DRESULT res, void* arg)
+{
+    SYNC_REQ* s = (SYNC_REQ*)arg;
+
+    s->res = res;
+    s->done = true;
+}
+
+// Queue a request and sleep until it is done
+static DRESULT sync_queue(SD_DRIVE* d, BYTE* buff, DWORD sector, BYTE count,
+                          REQ_OP op, BYTE cls)
 {
-    BYTE c; 
-    int i; 
-    uint32_t timeout;
+    SYNC_REQ s = { false, RES_OK };
+    DRESULT res;
 
-    if (drv != 0 || !count) return RES_PARERR;
-    if (Stat & STA_NOINIT) return RES_NOTRDY;
+    res = async_queue(d, buff, sector, count, op, cls, sync_done, &s, true);
+    if (res != RES_OK) return res;
 
-    for (c = 0; c < count; c++)
+    WAIT_FOR(s.done);
+    return s.res;
+}
+
+// ----------------------- Physical drive -----------------------
+static DSTATUS card_initialize(SD_DRIVE* d)
+{
+    uint8_t type = 0;
+    uint8_t res;
+    BYTE r7[4];
+    DWORD t0, dl;
+    int i;
+
+    // Let queued requests finish before the bus is reset
+    WAIT_FOR(d->a_count == 0);
+    t0 = Timer_ms;
+    d->stat |= STA_NOINIT;
+    d->card_busy = false;
+    d->s_open = false;
+    d->card.type = 0;
+    spi_init(d);
+
+    for (i = 0; i < 10; i++) spi_txrx(d, 0xFF);
+
+    if (send_cmd(d, 0, 0) != 1) {
+        cs_high(d);
+        return STA_NOINIT;
+    }
+
+    if (send_cmd(d, 8, 0x1AA) == 1)
     {
-        if (send_cmd(24, sector + c) != 0)
-            return RES_ERROR;
+        // R7: command version, reserved, accepted voltage, check pattern
+        spi_block(d, r7, 0, 4);
+        if ((r7[2] & 0x0F) == 0x01 && r7[3] == 0xAA) {
+            type = CT_SD2;
+        }
+    }
+
+    // ACMD41 loop, with HCS set for SDv2
+    dl = deadline(INIT_MS);
+    do
+    {
+        res = send_cmd(d, 55, 0);
+        if (res > 1) break;     // Not an SD card
+        res = send_cmd(d, 41, (type & CT_SD2) ? (1UL << 30) : 0);
+    } while (res == 1 && !expired(dl));
+
+    if (res == 0) {
+        if (!type) type = CT_SD1;
+    } else if (!type) {
+        // Fallback for MMC
+        dl = deadline(INIT_MS);
+        while ((res = send_cmd(d, 1, 0)) == 1 && !expired(dl));
+        if (res == 0) type = CT_MMC;
+    }
+    if (!type) {
+        cs_high(d);
+        return STA_NOINIT;
+    }
+
+    // OCR (R3). On SDv2, CCS set means block addressing.
+    if (send_cmd(d, 58, 0) == 0) {
+        spi_block(d, d->card.ocr, 0, 4);
+        if ((type & CT_SD2) && (d->card.ocr[0] & 0x40)) type |= CT_BLOCK;
+    }
+
+    // Byte-addressed cards may default to another block length
+    if (!(type & CT_BLOCK) && send_cmd(d, 16, 512) != 0) {
+        cs_high(d);
+        return STA_NOINIT;
+    }
+
+#if SD_USE_CRC
+    if (send_cmd(d, 59, 1) != 0) {
+        cs_high(d);
+        return STA_NOINIT;
+    }
+#endif
+    d->card.type = type;
+
+    // Switch to High Speed at 400 kHz, then raise the clock to the new limit
+    if (switch_high_speed(d)) d->card.type |= CT_HS;
+
+    if (!spi_negotiate(d) || !read_card_info(d)) {
+        d->card.type = 0;
+        cs_high(d);
+        return STA_NOINIT;
+    }
+
+    d->timing.init_ms = Timer_ms - t0;
+    d->stat &= ~STA_NOINIT;
+    cs_high(d);
+    return d->stat;
+}
+
+// Erase sectors dp[0]..dp[1]. The request engine runs it in turn with
+// queued I/O, and it returns once the card has accepted CMD38; the erase
+// itself completes in the background like a deferred write.
+static DRESULT erase_range(SD_DRIVE* d, DWORD* dp)
+{
+    const CARD_INFO* card = &d->card;
+
+    // SDv1 cards without ERASE_BLK_EN only erase whole sector groups
+    if (!(card->type & CT_SDC)) return RES_PARERR;
+    if (!(card->csd[0] >> 6) && !(card->csd[10] & 0x40)) return RES_PARERR;
+    if (dp[1] < dp[0] || dp[1] >= card->sectors) return RES_PARERR;
+
+    return sync_queue(d, (BYTE*)dp, dp[0], 1, REQ_ERASE, DISK_DATA);
+}
+
+// Wait for queued requests and the end of programming
+static DRESULT card_sync(SD_DRIVE* d)
+{
+    DRESULT res;
+
+    WAIT_FOR(d->a_count == 0);
+    if (!d->card_busy) return RES_OK;
+    cs_low(d);
+    res = wait_ready(d) ? RES_OK : RES_ERROR;
+    cs_high(d);
+    return res;
+}
+
+static DRESULT card_ioctl(SD_DRIVE* d, BYTE cmd, void* buff)
+{
+    const CARD_INFO* card = &d->card;
+
+    // Applies from the next disk_initialize()
+    if (cmd == MMC_SET_MAX_CLK) { d->clk_cap = *(DWORD*)buff; return RES_OK; }
+
+    if (cmd == MMC_GET_TIMING) { *(const DISK_TIMING**)buff = &d->timing; return RES_OK; }
+
+    if (cmd == MMC_GET_QSTATS) { *(const DISK_QSTATS**)buff = &d->qstats; return RES_OK; }
+
+    if (d->stat & STA_NOINIT) return RES_NOTRDY;
+
+    switch (cmd)
+    {
+        case GET_SECTOR_COUNT: *(DWORD*)buff = card->sectors; return RES_OK;
+        case GET_SECTOR_SIZE:  *(WORD*)buff = 512; return RES_OK;
+        case GET_BLOCK_SIZE:
+            if (!card->au_sectors) return RES_ERROR;
+            *(DWORD*)buff = card->au_sectors;
+            return RES_OK;
+        case MMC_GET_TYPE:  *(BYTE*)buff = card->type; return RES_OK;
+        case MMC_GET_CSD:   memcpy(buff, card->csd, 16); return RES_OK;
+        case MMC_GET_CID:   memcpy(buff, card->cid, 16); return RES_OK;
+        case MMC_GET_OCR:   memcpy(buff, card->ocr, 4); return RES_OK;
+        case MMC_GET_SDSTAT:
+            if (!(card->type & CT_SDC)) return RES_PARERR;
+            memcpy(buff, card->sdstat, 64);
+            return RES_OK;
+        case CTRL_ERASE_SECTOR: return erase_range(d, (DWORD*)buff);
+        case CTRL_SYNC: return card_sync(d);
+    }
+    return RES_PARERR;
+}
+
+// ----------------------- Striped drive -----------------------
+// Drive SD_STRIPE_DRV interleaves units of SD_STRIPE_SECTORS over all the
+// physical drives (RAID 0). A request is split at unit boundaries and each
+// piece is queued on its card, so the cards transfer in parallel. Its size
+// is that of the smallest card times the number of cards, and losing any
+// card loses the volume.
+#if SD_STRIPE
+static DWORD stripe_sectors;
+
+// Completion of the pieces of one request
+typedef struct {
+    volatile uint8_t left;      // Pieces not yet completed
+    volatile DRESULT res;       // First error
+} STRIPE_REQ;
+
+static void stripe_done(DRESULT res, void* arg)
+{
+    STRIPE_REQ* s = (STRIPE_REQ*)arg;
+
+    if (res != RES_OK && s->res == RES_OK) s->res = res;
+    s->left--;
+}
 
-        spi_txrx(0xFE); // Start block token
+static DSTATUS stripe_status(void)
+{
+    DSTATUS st = 0;
+    BYTE i;
+
+    for (i = 0; i < SD_DRIVES; i++) st |= drive_get(i)->stat;
+    return st;
+}
+
+static DSTATUS stripe_initialize(void)
+{
+    DWORD n = 0xFFFFFFFF;
+    BYTE i;
+
+    for (i = 0; i < SD_DRIVES; i++) {
+        SD_DRIVE* d = drive_get(i);
+
+        if (card_initialize(d) & STA_NOINIT) return STA_NOINIT;
+        if (d->card.sectors < n) n = d->card.sectors;
+    }
+    stripe_sectors = n / SD_STRIPE_SECTORS * SD_STRIPE_SECTORS * SD_DRIVES;
+    return 0;
+}
+
+static DRESULT stripe_io(BYTE* buff, DWORD sector, BYTE count, REQ_OP op,
+                         BYTE cls)
+{
+    STRIPE_REQ s;
+    DWORD unit;
+    UINT off, n;
+    DRESULT res;
+    bool masked;
 
-        for (i = 0; i < 512; i++)
-            spi_txrx(buff[c * 512 + i]);
+    if (!count) return RES_PARERR;
+    if (stripe_status() & STA_NOINIT) return RES_NOTRDY;
 
-        spi_txrx(0xFF); // Write 16-bit CRC (dummy)
-        spi_txrx(0xFF);
+    s.left = (sector % SD_STRIPE_SECTORS + count + SD_STRIPE_SECTORS - 1) /
+             SD_STRIPE_SECTORS;
+    s.res = RES_OK;
 
-        uint8_t resp = spi_txrx(0xFF);
-        if ((resp & 0x1F) != 0x05)
-            return RES_ERROR;
+    while (count) {
+        unit = sector / SD_STRIPE_SECTORS;
+        off = sector % SD_STRIPE_SECTORS;
+        n = SD_STRIPE_SECTORS - off;
+        if (n > count) n = count;
 
-        // --- CRITICAL FIX 2: ROBUST BUSY WAIT ---
-        // Add robust software timeout for card internal programming.
-        timeout = 0;
-        while(spi_txrx(0xFF) != 0xFF) {
-            if (timeout++ > 0x100000) return RES_ERROR; // Increased timeout for stability
+        res = async_queue(&Drives[unit % SD_DRIVES], buff,
+                          unit / SD_DRIVES * SD_STRIPE_SECTORS + off, (BYTE)n,
+                          op, cls, stripe_done, &s, true);
+        if (res != RES_OK) {
+            masked = IntMasterDisable();
+            stripe_done(res, &s);
+            if (!masked) IntMasterEnable();
         }
-        
-        spi_txrx(0xFF); // Trailing clock pulse
 
-        cs_high();
+        buff += n * 512;
+        sector += n;
+        count -= n;
     }
-    return RES_OK;
+
+    WAIT_FOR(s.left == 0);
+    return s.res;
 }
 
-DRESULT disk_ioctl(BYTE drv, BYTE cmd, void* buff)
+static DRESULT stripe_ioctl(BYTE cmd, void* buff)
 {
-    if (drv != 0) return RES_PARERR;
-    if (Stat & STA_NOINIT) return RES_NOTRDY;
+    DRESULT res;
+    BYTE i;
+
+    if (stripe_status() & STA_NOINIT) return RES_NOTRDY;
 
     switch (cmd)
     {
-        case GET_SECTOR_SIZE: *(WORD*)buff = 512; return RES_OK;
-        case GET_BLOCK_SIZE:  *(DWORD*)buff = 1;  return RES_OK;
-        case CTRL_SYNC: return RES_OK; 
+        case GET_SECTOR_COUNT: *(DWORD*)buff = stripe_sectors; return RES_OK;
+        case GET_SECTOR_SIZE:  *(WORD*)buff = 512; return RES_OK;
+        case GET_BLOCK_SIZE:
+            // One erase block on every card
+            if (!Drives[0].card.au_sectors) return RES_ERROR;
+            *(DWORD*)buff = Drives[0].card.au_sectors * SD_DRIVES;
+            return RES_OK;
+        case CTRL_SYNC:
+            for (i = 0; i < SD_DRIVES; i++) {
+                res = card_sync(&Drives[i]);
+                if (res != RES_OK) return res;
+            }
+            return RES_OK;
     }
     return RES_PARERR;
-}
\ No newline at end of file
+}
+#endif
+
+// ----------------------- Disk I/O API -----------------------
+DSTATUS disk_initialize(BYTE drv)
+{
+#if SD_STRIPE
+    if (drv == SD_STRIPE_DRV) return stripe_initialize();
+#endif
+    if (drv >= SD_DRIVES) return STA_NOINIT;
+    return card_initialize(drive_get(drv));
+}
+
+DSTATUS disk_status(BYTE drv)
+{
+#if SD_STRIPE
+    if (drv == SD_STRIPE_DRV) return stripe_status();
+#endif
+    if (drv >= SD_DRIVES) return STA_NOINIT;
+    return drive_get(drv)->stat;
+}
+
+// ----------------------- Read / Write -----------------------
+// The asynchronous functions return once the request is queued (RES_NOTRDY
+// if the queue is full); cb(res, arg) runs from the drive's SSI interrupt
+// when it ends. The blocking functions queue a request and sleep until it
+// is done. The striped drive has no asynchronous form.
+//
+// disk_read_meta()/disk_write_meta() queue metadata requests, which start
+// ahead of older data requests; everything else is data. FatFs only calls
+// disk_read()/disk_write(), so the ordering is for direct callers.
+DRESULT disk_read_async(BYTE drv, BYTE* buff, DWORD sector, BYTE count,
+                        DISK_CALLBACK cb, void* arg)
+{
+    if (drv >= SD_DRIVES) return RES_PARERR;
+    return async_queue(drive_get(drv), buff, sector, count, REQ_READ, DISK_DATA,
+                       cb, arg, false);
+}
+
+DRESULT disk_write_async(BYTE drv, const BYTE* buff, DWORD sector, BYTE count,
+                         DISK_CALLBACK cb, void* arg)
+{
+    if (drv >= SD_DRIVES) return RES_PARERR;
+    // The engine only reads from a write request's buffer
+    return async_queue(drive_get(drv), (BYTE*)buff, sector, count, REQ_WRITE,
+                       DISK_DATA, cb, arg, false);
+}
+
+static DRESULT disk_io(BYTE drv, BYTE* buff, DWORD sector, BYTE count,
+                       REQ_OP op, BYTE cls)
+{
+#if SD_STRIPE
+    if (drv == SD_STRIPE_DRV) return stripe_io(buff, sector, count, op, cls);
+#endif
+    if (drv >= SD_DRIVES) return RES_PARERR;
+    return sync_queue(drive_get(drv), buff, sector, count, op, cls);
+}
+
+DRESULT disk_read(BYTE drv, BYTE* buff, DWORD sector, BYTE count)
+{
+    return disk_io(drv, buff, sector, count, REQ_READ, DISK_DATA);
+}
+
+DRESULT disk_write(BYTE drv, const BYTE* buff, DWORD sector, BYTE count)
+{
+    return disk_io(drv, (BYTE*)buff, sector, count, REQ_WRITE, DISK_DATA);
+}
+
+DRESULT disk_read_meta(BYTE drv, BYTE* buff, DWORD sector, BYTE count)
+{
+    return disk_io(drv, buff, sector, count, REQ_READ, DISK_META);
+}
+
+DRESULT disk_write_meta(BYTE drv, const BYTE* buff, DWORD sector, BYTE count)
+{
+    return disk_io(drv, (BYTE*)buff, sector, count, REQ_WRITE, DISK_META);
+}
+
+DRESULT disk_ioctl(BYTE drv, BYTE cmd, void* buff)
+{
+#if SD_STRIPE
+    if (drv == SD_STRIPE_DRV) return stripe_ioctl(cmd, buff);
+#endif
+    if (drv >= SD_DRIVES) return RES_PARERR;
+    return card_ioctl(drive_get(drv), cmd, buff);
+}
@@ -14,6 +14,18 @@ extern "C" {
 
 #include "integer.h"
 
+/* Physical drives 0..SD_DRIVES-1 are cards on SSI0, SSI2, SSI3 and SSI1 in
+/  that order (see diskio.c for the pins). With SD_STRIPE set to 1, drive
+/  SD_STRIPE_DRV stripes its sectors over all of them. _VOLUMES in ffconf.h
+/  must be at least SD_DRIVES + SD_STRIPE; ff.c checks it. */
+#ifndef SD_DRIVES
+#define SD_DRIVES		1
+#endif
+#ifndef SD_STRIPE
+#define SD_STRIPE		0
+#endif
+#define SD_STRIPE_DRV	SD_DRIVES
+
 
 /* Status of Disk Functions */
 typedef BYTE	DSTATUS;
@@ -27,6 +39,45 @@ typedef enum {
 	RES_PARERR		/* 4: Invalid Parameter */
 } DRESULT;
 
+/* Completion callback of the asynchronous functions. It is called from the
+/  drive's SSI interrupt and may queue another request, but must not call the
+/  blocking functions. A write completes once the card has accepted the
+/  data; it may still be programming until CTRL_SYNC returns. */
+typedef void (*DISK_CALLBACK) (DRESULT res, void* arg);
+
+/* Timing statistics (MMC_GET_TIMING). A command is timed from its selection
+/  to the next command or the end of the transaction, so data and busy phases
+/  are included. ACMDs count under their own index. */
+typedef struct {
+	DWORD	init_ms;		/* Duration of the last successful disk_initialize */
+	DWORD	cmd_max_us[64];	/* Longest time per command index, in us */
+} DISK_TIMING;
+
+/* Request classes. Metadata requests start ahead of queued data requests.
+/  The scheduler only applies to callers of the disk functions themselves:
+/  FatFs does all of its I/O through disk_read/disk_write, which queue data
+/  and wait for it, so its requests are never reordered or chained. An
+/  application that posts data with disk_write_async can put its own
+/  metadata ahead of it with disk_read_meta/disk_write_meta. */
+#define DISK_DATA	0
+#define DISK_META	1
+
+/* Queue statistics (MMC_GET_QSTATS). Wait times run from queueing to the
+/  start of the request, per class. With FatFs as the only user of a card
+/  that is not striped, bypassed and merged stay 0, depth_max stays 1 and
+/  the waits only show the start latency; queued still counts the requests
+/  per class. */
+typedef struct {
+	DWORD	queued[2];		/* Requests queued */
+	DWORD	writes[2];		/* ... of which writes */
+	DWORD	wait_us[2];		/* Total wait, in us */
+	DWORD	wait_max_us[2];	/* Longest wait, in us */
+	DWORD	bypassed;		/* Requests started ahead of an older one */
+	DWORD	merged;			/* Writes chained onto the CMD25 of the one before */
+	BYTE	depth;			/* Requests in the queue now, running one included */
+	BYTE	depth_max;		/* Highest depth seen */
+} DISK_QSTATS;
+
 
 /*---------------------------------------*/
 /* Prototypes for disk control functions */
@@ -37,7 +88,11 @@ DSTATUS disk_status (BYTE pdrv);
 DRESULT disk_read (BYTE pdrv, BYTE*buff, DWORD sector, BYTE count);
 DRESULT disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, BYTE count);
 DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
-void	disk_timerproc (void);
+DRESULT disk_read_async (BYTE pdrv, BYTE* buff, DWORD sector, BYTE count, DISK_CALLBACK cb, void* arg);
+DRESULT disk_write_async (BYTE pdrv, const BYTE* buff, DWORD sector, BYTE count, DISK_CALLBACK cb, void* arg);
+DRESULT disk_read_meta (BYTE pdrv, BYTE* buff, DWORD sector, BYTE count);
+DRESULT disk_write_meta (BYTE pdrv, const BYTE* buff, DWORD sector, BYTE count);
+void	disk_timerproc (void);	/* Call every 1 ms */
 
 /* Disk Status Bits (DSTATUS) */
 #define STA_NOINIT		0x01	/* Drive not initialized */
@@ -66,6 +121,9 @@ void	disk_timerproc (void);
 #define MMC_GET_CID			12	/* Get CID */
 #define MMC_GET_OCR			13	/* Get OCR */
 #define MMC_GET_SDSTAT		14	/* Get SD status */
+#define MMC_SET_MAX_CLK		15	/* Set SPI clock cap in Hz for disk_initialize (0: none) */
+#define MMC_GET_TIMING		16	/* Get pointer to timing statistics (DISK_TIMING) */
+#define MMC_GET_QSTATS		17	/* Get pointer to queue statistics (DISK_QSTATS) */
 
 /* ATA/CF specific ioctl command */
 #define ATA_GET_REV			20	/* Get F/W revision */
@@ -79,6 +137,7 @@ void	disk_timerproc (void);
 #define CT_SD2		0x04		/* SD ver 2 */
 #define CT_SDC		(CT_SD1|CT_SD2)	/* SD */
 #define CT_BLOCK	0x08		/* Block addressing */
+#define CT_HS		0x10		/* Switched to High Speed mode (CMD6) */
 
 
 #ifdef __cplusplus
@@ -0,0 +1,269 @@
+//*****************************************************************************
+//
+// udma.h - Prototypes and macros for the uDMA controller.
+//
+// Copyright (c) 2007-2020 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+// 
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions
+//   are met:
+// 
+//   Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// 
+//   Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the  
+//   distribution.
+// 
+//   Neither the name of Texas Instruments Incorporated nor the names of
+//   its contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// This is part of revision 2.2.0.295 of the Tiva Peripheral Driver Library.
+//
+
+#ifndef __DRIVERLIB_UDMA_H__
+#define __DRIVERLIB_UDMA_H__
+
+//*****************************************************************************
+//
+// If building with a C++ compiler, make all of the definitions in this header
+// have a C binding.
+//
+//*****************************************************************************
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+//*****************************************************************************
+//
+//! \addtogroup udma_api
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+// A structure that defines an entry in the channel control table.  These
+// fields are used by the uDMA controller and normally it is not necessary for
+// software to directly read or write fields in the table.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    // The ending source address of the data transfer.
+    //
+    volatile void *pvSrcEndAddr;
+
+    //
+    // The ending destination address of the data transfer.
+    //
+    volatile void *pvDstEndAddr;
+
+    //
+    // The channel control mode.
+    //
+    volatile uint32_t ui32Control;
+
+    //
+    // An unused location.
+    //
+    volatile uint32_t ui32Spare;
+}
+tDMAControlTable;
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+// Flags that can be passed to uDMAChannelAttributeEnable(),
+// uDMAChannelAttributeDisable(), and returned from uDMAChannelAttributeGet().
+//
+//*****************************************************************************
+#define UDMA_ATTR_USEBURST      0x00000001
+#define UDMA_ATTR_ALTSELECT     0x00000002
+#define UDMA_ATTR_HIGH_PRIORITY 0x00000004
+#define UDMA_ATTR_REQMASK       0x00000008
+#define UDMA_ATTR_ALL           0x0000000F
+
+//*****************************************************************************
+//
+// DMA control modes that can be passed to uDMAModeSet() and returned
+// uDMAModeGet().
+//
+//*****************************************************************************
+#define UDMA_MODE_STOP          0x00000000
+#define UDMA_MODE_BASIC         0x00000001
+#define UDMA_MODE_AUTO          0x00000002
+#define UDMA_MODE_PINGPONG      0x00000003
+#define UDMA_MODE_MEM_SCATTER_GATHER                                          \
+                                0x00000004
+#define UDMA_MODE_PER_SCATTER_GATHER                                          \
+                                0x00000006
+#define UDMA_MODE_ALT_SELECT    0x00000001
+
+//*****************************************************************************
+//
+// Channel configuration values that can be passed to uDMAControlSet().
+//
+//*****************************************************************************
+#define UDMA_DST_INC_8          0x00000000
+#define UDMA_DST_INC_16         0x40000000
+#define UDMA_DST_INC_32         0x80000000
+#define UDMA_DST_INC_NONE       0xc0000000
+#define UDMA_SRC_INC_8          0x00000000
+#define UDMA_SRC_INC_16         0x04000000
+#define UDMA_SRC_INC_32         0x08000000
+#define UDMA_SRC_INC_NONE       0x0c000000
+#define UDMA_SIZE_8             0x00000000
+#define UDMA_SIZE_16            0x11000000
+#define UDMA_SIZE_32            0x22000000
+#define UDMA_DST_PROT_PRIV      0x00200000
+#define UDMA_SRC_PROT_PRIV      0x00040000
+#define UDMA_ARB_1              0x00000000
+#define UDMA_ARB_2              0x00004000
+#define UDMA_ARB_4              0x00008000
+#define UDMA_ARB_8              0x0000c000
+#define UDMA_ARB_16             0x00010000
+#define UDMA_ARB_32             0x00014000
+#define UDMA_ARB_64             0x00018000
+#define UDMA_ARB_128            0x0001c000
+#define UDMA_ARB_256            0x00020000
+#define UDMA_ARB_512            0x00024000
+#define UDMA_ARB_1024           0x00028000
+#define UDMA_NEXT_USEBURST      0x00000008
+
+//*****************************************************************************
+//
+// Flags to be OR'd with the channel ID to indicate if the primary or alternate
+// control structure should be used.
+//
+//*****************************************************************************
+#define UDMA_PRI_SELECT         0x00000000
+#define UDMA_ALT_SELECT         0x00000020
+
+//*****************************************************************************
+//
+// Channel numbers to be passed to API functions that require a channel number
+// ID.
+//
+//*****************************************************************************
+#define UDMA_CHANNEL_USBEP1RX   0
+#define UDMA_CHANNEL_USBEP1TX   1
+#define UDMA_CHANNEL_USBEP2RX   2
+#define UDMA_CHANNEL_USBEP2TX   3
+#define UDMA_CHANNEL_USBEP3RX   4
+#define UDMA_CHANNEL_USBEP3TX   5
+#define UDMA_CHANNEL_ETH0RX     6
+#define UDMA_CHANNEL_ETH0TX     7
+#define UDMA_CHANNEL_UART0RX    8
+#define UDMA_CHANNEL_UART0TX    9
+#define UDMA_CHANNEL_SSI0RX     10
+#define UDMA_CHANNEL_SSI0TX     11
+#define UDMA_CHANNEL_ADC0       14
+#define UDMA_CHANNEL_ADC1       15
+#define UDMA_CHANNEL_ADC2       16
+#define UDMA_CHANNEL_ADC3       17
+#define UDMA_CHANNEL_TMR0A      18
+#define UDMA_CHANNEL_TMR0B      19
+#define UDMA_CHANNEL_TMR1A      20
+#define UDMA_CHANNEL_TMR1B      21
+#define UDMA_CHANNEL_UART1RX    22
+#define UDMA_CHANNEL_UART1TX    23
+#define UDMA_CHANNEL_SSI1RX     24
+#define UDMA_CHANNEL_SSI1TX     25
+#define UDMA_CHANNEL_SW         30
+
+//*****************************************************************************
+//
+// Channel numbers for the secondary (encoding 2) peripheral assignments.
+//
+//*****************************************************************************
+#define UDMA_SEC_CHANNEL_SSI2RX 12
+#define UDMA_SEC_CHANNEL_SSI2TX 13
+#define UDMA_SEC_CHANNEL_SSI3RX 14
+#define UDMA_SEC_CHANNEL_SSI3TX 15
+
+//*****************************************************************************
+//
+// Values that can be passed to uDMAChannelAssign() to select a peripheral
+// mapping for each channel.  The channel number is in bits 7:0 and the
+// encoding in bits 23:16.
+//
+//*****************************************************************************
+#define UDMA_CH10_SSI0RX        0x0000000A
+#define UDMA_CH11_SSI0TX        0x0000000B
+#define UDMA_CH24_SSI1RX        0x00000018
+#define UDMA_CH25_SSI1TX        0x00000019
+#define UDMA_CH10_SSI1RX        0x0001000A
+#define UDMA_CH11_SSI1TX        0x0001000B
+#define UDMA_CH12_SSI2RX        0x0002000C
+#define UDMA_CH13_SSI2TX        0x0002000D
+#define UDMA_CH14_SSI3RX        0x0002000E
+#define UDMA_CH15_SSI3TX        0x0002000F
+
+//*****************************************************************************
+//
+// API Function prototypes
+//
+//*****************************************************************************
+extern void uDMAEnable(void);
+extern void uDMADisable(void);
+extern uint32_t uDMAErrorStatusGet(void);
+extern void uDMAErrorStatusClear(void);
+extern void uDMAChannelEnable(uint32_t ui32ChannelNum);
+extern void uDMAChannelDisable(uint32_t ui32ChannelNum);
+extern bool uDMAChannelIsEnabled(uint32_t ui32ChannelNum);
+extern void uDMAControlBaseSet(void *pControlTable);
+extern void *uDMAControlBaseGet(void);
+extern void uDMAChannelRequest(uint32_t ui32ChannelNum);
+extern void uDMAChannelAttributeEnable(uint32_t ui32ChannelNum,
+                                       uint32_t ui32Attr);
+extern void uDMAChannelAttributeDisable(uint32_t ui32ChannelNum,
+                                        uint32_t ui32Attr);
+extern uint32_t uDMAChannelAttributeGet(uint32_t ui32ChannelNum);
+extern void uDMAChannelControlSet(uint32_t ui32ChannelStructIndex,
+                                  uint32_t ui32Control);
+extern void uDMAChannelTransferSet(uint32_t ui32ChannelStructIndex,
+                                   uint32_t ui32Mode, void *pvSrcAddr,
+                                   void *pvDstAddr,
+                                   uint32_t ui32TransferSize);
+extern uint32_t uDMAChannelSizeGet(uint32_t ui32ChannelStructIndex);
+extern uint32_t uDMAChannelModeGet(uint32_t ui32ChannelStructIndex);
+extern void uDMAIntRegister(uint32_t ui32IntChannel, void (*pfnHandler)(void));
+extern void uDMAIntUnregister(uint32_t ui32IntChannel);
+extern uint32_t uDMAIntStatus(void);
+extern void uDMAIntClear(uint32_t ui32ChanMask);
+extern void uDMAChannelAssign(uint32_t ui32Mapping);
+
+//*****************************************************************************
+//
+// Mark the end of the C bindings section for C++ compilers.
+//
+//*****************************************************************************
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __DRIVERLIB_UDMA_H__
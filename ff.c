@@ -98,6 +98,8 @@
 
 #include "ff.h"			/* FatFs configurations and declarations */
 #include "diskio.h"		/* Declarations of low level disk I/O functions */
+#include <stddef.h>		/* offsetof() for the check on win[] */
+#include <string.h>		/* memcpy() for the word loads of the FAT scanning kernels */
 
 
 /*--------------------------------------------------------------------------
@@ -111,6 +113,20 @@
 #endif
 
 
+#if _FS_TINY && _FS_WINCACHE
+#error _FS_WINCACHE must be 0 on tiny cfg.
+#endif
+#if _FS_TAILCACHE && _FS_TINY
+#error _FS_TAILCACHE must be 0 on tiny cfg.
+#endif
+#if _FS_READONLY && _FS_FREEMAP
+#error _FS_FREEMAP must be 0 on read-only cfg.
+#endif
+#if !_MULTI_PARTITION && _VOLUMES < SD_DRIVES + SD_STRIPE
+#error _VOLUMES must cover SD_DRIVES + SD_STRIPE (diskio.h).
+#endif
+
+
 /* Definitions on sector size */
 #if _MAX_SS != 512 && _MAX_SS != 1024 && _MAX_SS != 2048 && _MAX_SS != 4096
 #error Wrong sector size.
@@ -137,6 +153,14 @@
 #define	ABORT(fs, res)		{ fp->flag |= FA__ERROR; LEAVE_FF(fs, res); }
 
 
+/* Access counters */
+#if _FS_STATS
+#define	STAT_INC(fs, ctr)	((fs)->stats.ctr++)
+#else
+#define	STAT_INC(fs, ctr)
+#endif
+
+
 /* File access control feature */
 #if _FS_LOCK
 #if _FS_READONLY
@@ -727,27 +751,162 @@ void clear_lock (	/* Clear lock entries of the volume */
 /*-----------------------------------------------------------------------*/
 
 
+#if !_FS_READONLY
+static
+FRESULT write_meta (	/* Write a metadata sector and reflect it to the FAT copies */
+	FATFS *fs,		/* File system object */
+	const BYTE *buf,	/* Sector data */
+	DWORD sect		/* Sector number */
+)
+{
+	UINT nf;
+
+
+	if (disk_write(fs->drv, buf, sect, 1) != RES_OK)
+		return FR_DISK_ERR;
+	if (sect >= fs->fatbase && sect < (fs->fatbase + fs->fsize)) {	/* In FAT area? */
+		for (nf = fs->n_fats; nf >= 2; nf--) {	/* Reflect the change to all FAT copies */
+			sect += fs->fsize;
+			disk_write(fs->drv, buf, sect, 1);
+		}
+	}
+	STAT_INC(fs, win_flush);
+	return FR_OK;
+}
+#endif
+
+
+#if _FS_WINCACHE
+/* Sector cache behind the window. A sector leaving the window is kept in a
+/  cache entry with its dirty state, and moving back to it costs a copy
+/  instead of a disk read. The window buffer itself stays put, so pointers
+/  into fs->win remain valid across move_window() as before. */
+
+static
+int cache_find (	/* Entry index, or -1 if the sector is not cached */
+	FATFS *fs,		/* File system object */
+	DWORD sect		/* Sector number */
+)
+{
+	int i;
+
+
+	for (i = 0; i < _FS_WINCACHE; i++) {
+		if (fs->wc_sect[i] == sect) return i;
+	}
+	return -1;
+}
+
+
+static
+int cache_alloc (	/* Index of an emptied entry, or -1 on disk error */
+	FATFS *fs		/* File system object */
+)
+{
+	int i, v = 0;
+
+
+	for (i = 0; i < _FS_WINCACHE; i++) {
+		if (fs->wc_sect[i] == 0xFFFFFFFF) return i;		/* Empty entry */
+		if (fs->wc_tick - fs->wc_used[i] > fs->wc_tick - fs->wc_used[v])
+			v = i;											/* Least recently used */
+	}
+#if !_FS_READONLY
+	if (fs->wc_dirty[v]) {		/* Write back the victim */
+		if (write_meta(fs, fs->wc_buf[v], fs->wc_sect[v]) != FR_OK)
+			return -1;
+		fs->wc_dirty[v] = 0;
+	}
+#endif
+	fs->wc_sect[v] = 0xFFFFFFFF;
+	return v;
+}
+
+
+static
+void cache_reset (
+	FATFS *fs		/* File system object */
+)
+{
+	int i;
+
+
+	for (i = 0; i < _FS_WINCACHE; i++) {
+		fs->wc_sect[i] = 0xFFFFFFFF;
+		fs->wc_dirty[i] = 0;
+	}
+}
+
+
+#if !_FS_READONLY
+static
+FRESULT cache_store (	/* Move a dirty window into its cache entry */
+	FATFS *fs		/* File system object */
+)
+{
+	int i;
+
+
+	if (fs->wflag) {
+		i = cache_find(fs, fs->winsect);
+		if (i < 0) i = cache_alloc(fs);
+		if (i < 0) return FR_DISK_ERR;
+		mem_cpy(fs->wc_buf[i], fs->win, SS(fs));
+		fs->wc_sect[i] = fs->winsect;
+		fs->wc_used[i] = ++fs->wc_tick;
+		fs->wc_dirty[i] = 1;
+		fs->wflag = 0;
+	}
+	return FR_OK;
+}
+
+
+static
+FRESULT cache_flush (	/* Write back all dirty entries in ascending sector order */
+	FATFS *fs		/* File system object */
+)
+{
+	int i, n;
+
+
+	for (;;) {
+		n = -1;
+		for (i = 0; i < _FS_WINCACHE; i++) {
+			if (fs->wc_dirty[i] && (n < 0 || fs->wc_sect[i] < fs->wc_sect[n]))
+				n = i;
+		}
+		if (n < 0) return FR_OK;
+		if (write_meta(fs, fs->wc_buf[n], fs->wc_sect[n]) != FR_OK)
+			return FR_DISK_ERR;
+		fs->wc_dirty[n] = 0;
+	}
+}
+#endif
+#endif
+
+
 #if !_FS_READONLY
 static
 FRESULT sync_window (
 	FATFS *fs		/* File system object */
 )
 {
-	DWORD wsect;
-	UINT nf;
+#if _FS_WINCACHE
+	int i;
+#endif
 
 	
 	if (fs->wflag) {	/* Write back the sector if it is dirty */
-		wsect = fs->winsect;	/* Current sector number */
-		if (disk_write(fs->drv, fs->win, wsect, 1) != RES_OK)
+		if (write_meta(fs, fs->win, fs->winsect) != FR_OK)
 			return FR_DISK_ERR;
 		fs->wflag = 0;
-		if (wsect >= fs->fatbase && wsect < (fs->fatbase + fs->fsize)) {	/* In FAT area? */
-			for (nf = fs->n_fats; nf >= 2; nf--) {	/* Reflect the change to all FAT copies */
-				wsect += fs->fsize;
-				disk_write(fs->drv, fs->win, wsect, 1);
-			}
+#if _FS_WINCACHE
+		i = cache_find(fs, fs->winsect);	/* Keep the cached copy up to date */
+		if (i >= 0) {
+			mem_cpy(fs->wc_buf[i], fs->win, SS(fs));
+			fs->wc_dirty[i] = 0;
 		}
+#endif
 	}
 	return FR_OK;
 }
@@ -760,14 +919,40 @@ FRESULT move_window (
 	DWORD sector	/* Sector number to make appearance in the fs->win[] */
 )
 {
+#if _FS_WINCACHE
+	int i;
+#endif
+
 	if (sector != fs->winsect) {	/* Changed current window */
+#if _FS_WINCACHE
+#if !_FS_READONLY
+		if (cache_store(fs) != FR_OK)	/* Keep the outgoing sector if dirty */
+			return FR_DISK_ERR;
+#endif
+		i = cache_find(fs, sector);
+		if (i >= 0) {					/* Cache hit */
+			STAT_INC(fs, win_cached);
+		} else {						/* Load the sector into a free entry */
+			i = cache_alloc(fs);
+			if (i < 0 || disk_read(fs->drv, fs->wc_buf[i], sector, 1) != RES_OK)
+				return FR_DISK_ERR;
+			fs->wc_sect[i] = sector;
+			STAT_INC(fs, win_miss);
+		}
+		fs->wc_used[i] = ++fs->wc_tick;
+		mem_cpy(fs->win, fs->wc_buf[i], SS(fs));
+#else
 #if !_FS_READONLY
 		if (sync_window(fs) != FR_OK)
 			return FR_DISK_ERR;
 #endif
 		if (disk_read(fs->drv, fs->win, sector, 1) != RES_OK)
 			return FR_DISK_ERR;
+		STAT_INC(fs, win_miss);
+#endif
 		fs->winsect = sector;
+	} else {
+		STAT_INC(fs, win_hit);
 	}
 
 	return FR_OK;
@@ -788,7 +973,13 @@ FRESULT sync_fs (	/* FR_OK: successful, FR_DISK_ERR: failed */
 	FRESULT res;
 
 
+#if _FS_WINCACHE
+	res = cache_store(fs);
+	if (res == FR_OK)
+		res = cache_flush(fs);
+#else
 	res = sync_window(fs);
+#endif
 	if (res == FR_OK) {
 		/* Update FSInfo sector if needed */
 		if (fs->fs_type == FS_FAT32 && fs->fsi_flag) {
@@ -850,6 +1041,7 @@ DWORD get_fat (	/* 0xFFFFFFFF:Disk error, 1:Internal error, Else:Cluster status
 
 	if (clst < 2 || clst >= fs->n_fatent)	/* Check range */
 		return 1;
+	STAT_INC(fs, fat_get);
 
 	switch (fs->fs_type) {
 	case FS_FAT12 :
@@ -881,6 +1073,24 @@ DWORD get_fat (	/* 0xFFFFFFFF:Disk error, 1:Internal error, Else:Cluster status
 /* FAT access - Change value of a FAT entry                              */
 /*-----------------------------------------------------------------------*/
 #if !_FS_READONLY
+#if _FS_FREEMAP
+static
+void fmap_mark (	/* Reflect a FAT entry change to the free map */
+	FATFS *fs,		/* File system object */
+	DWORD clst,		/* Cluster# */
+	DWORD val		/* New value of the FAT entry */
+)
+{
+	DWORD m = clst >> fs->fm_shift;
+
+
+	if (!(val & 0x0FFFFFFF))				/* Freed: the group has a free cluster */
+		fs->fmap[m / 32] |= 1UL << (m % 32);
+	else if (!fs->fm_shift)					/* Allocated: exact map only */
+		fs->fmap[m / 32] &= ~(1UL << (m % 32));
+}
+#endif
+
 
 FRESULT put_fat (
 	FATFS *fs,	/* File system object */
@@ -897,6 +1107,10 @@ FRESULT put_fat (
 		res = FR_INT_ERR;
 
 	} else {
+		STAT_INC(fs, fat_put);
+#if _FS_FREEMAP
+		fmap_mark(fs, clst, val);
+#endif
 		switch (fs->fs_type) {
 		case FS_FAT12 :
 			bc = (UINT)clst; bc += bc / 2;
@@ -940,9 +1154,176 @@ FRESULT put_fat (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Sector scanning kernels (FAT16/32)                     */
+/*-----------------------------------------------------------------------*/
+/* The kernels look at entries i to n-1 of the FAT sector in the win[].
+/  They load 32 bits at a time: a FAT32 entry is tested for zero under the
+/  mask of its low 28 bits and a pair of FAT16 entries with a SIMD-within-a-
+/  register test. The byte order matters only where entry values are
+/  compared. Words are loaded with memcpy(), which compilers turn into a
+/  single load and which makes no assumption on aliasing; win[] is kept
+/  word aligned in the FATFS so that the load is an aligned one. */
+
+#if !_FS_READONLY
+typedef char WinAligned[(offsetof(FATFS, win) & 3) ? -1 : 1];	/* Fails to compile if win[] moves off a word boundary */
+
+static const union {
+	BYTE b[4];
+	DWORD d;
+} Fat28Mask = {{0xFF, 0xFF, 0xFF, 0x0F}};	/* Low 28 bits of a FAT32 entry in the memory byte order */
+
+#define	LE_CPU	(Fat28Mask.d == 0x0FFFFFFF)	/* Little-endian CPU? */
+#define	NZ16(w)	(((((w) & 0x7FFF7FFF) + 0x7FFF7FFF) | (w)) & 0x80008000)	/* Bit 15 of each half set if the half is not zero */
+
+
+static
+DWORD ld_mem32 (	/* 32-bit word at p in the memory byte order */
+	const BYTE* p
+)
+{
+	DWORD w;
+
+
+	memcpy(&w, p, 4);
+	return w;
+}
+
+
+#if _FS_MINIMIZE == 0 && !_FS_FREEMAP
+static
+UINT fat_count0 (	/* Number of zero entries in i to n-1 */
+	const BYTE* win,	/* FAT sector */
+	UINT i,				/* First entry */
+	UINT n,				/* End of entries */
+	BYTE fmt			/* FS_FAT16 or FS_FAT32 */
+)
+{
+	DWORD w, m;
+	UINT nz = 0;
+
+
+	if (fmt == FS_FAT32) {
+		m = Fat28Mask.d;
+		for ( ; i < n; i++) nz += !(ld_mem32(win + i * 4) & m);
+	} else {
+		if ((i & 1) && i < n) {			/* Odd head entry */
+			nz += !LD_WORD(win + i * 2);
+			i++;
+		}
+		for ( ; i + 2 <= n; i += 2) {		/* Two entries per word */
+			w = ld_mem32(win + i * 2);
+			w = NZ16(w);
+			nz += 2 - (UINT)(w >> 31) - (UINT)(w >> 15 & 1);
+		}
+		if (i < n) nz += !LD_WORD(win + i * 2);	/* Odd tail entry */
+	}
+	return nz;
+}
+#endif
+
+
+static
+UINT fat_find0 (	/* Index of the first zero entry in i to n-1 (n:None) */
+	const BYTE* win,	/* FAT sector */
+	UINT i,				/* First entry */
+	UINT n,				/* End of entries */
+	BYTE fmt			/* FS_FAT16 or FS_FAT32 */
+)
+{
+	DWORD w, m;
+
+
+	if (fmt == FS_FAT32) {
+		m = Fat28Mask.d;
+		while (i < n && (ld_mem32(win + i * 4) & m)) i++;
+		return i;
+	}
+	if (i & 1) {						/* Odd head entry */
+		if (i >= n || !LD_WORD(win + i * 2)) return i;
+		i++;
+	}
+	for ( ; i + 2 <= n; i += 2) {		/* Skip pairs of used entries */
+		w = ld_mem32(win + i * 2);
+		if (NZ16(w) != 0x80008000) break;
+	}
+	for ( ; i < n && LD_WORD(win + i * 2); i++) ;	/* Locate it in the pair or tail */
+	return i;
+}
+
+
+static
+UINT fat_run (	/* Number of entries from i holding the next cluster# (entry i+k is clst+k+1) */
+	const BYTE* win,	/* FAT sector */
+	UINT i,				/* First entry */
+	UINT n,				/* End of entries */
+	DWORD clst,			/* Cluster# of entry i */
+	BYTE fmt			/* FS_FAT16 or FS_FAT32 */
+)
+{
+	UINT k = i;
+
+
+	if (fmt == FS_FAT32) {
+		if (LE_CPU) {					/* The loaded word is the entry value */
+			while (k < n && (ld_mem32(win + k * 4) & 0x0FFFFFFF) == ++clst) k++;
+		} else {
+			while (k < n && (LD_DWORD(win + k * 4) & 0x0FFFFFFF) == ++clst) k++;
+		}
+	} else {
+		while (k < n && LD_WORD(win + k * 2) == ++clst) k++;
+	}
+	return k - i;
+}
+
+
+static
+void fat_clear (	/* Mark entries i to i+n-1 "empty" */
+	BYTE* win,		/* FAT sector */
+	UINT i,			/* First entry */
+	UINT n,			/* Number of entries */
+	BYTE fmt		/* FS_FAT16 or FS_FAT32 */
+)
+{
+	if (fmt == FS_FAT32) {
+		for (win += i * 4; n; n--, win += 4) {	/* Keep the upper 4 bits */
+			win[0] = win[1] = win[2] = 0;
+			win[3] &= 0xF0;
+		}
+	} else {
+		mem_set(win + i * 2, 0, n * 2);
+	}
+}
+#endif /* !_FS_READONLY */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* FAT handling - Remove a cluster chain                                 */
 /*-----------------------------------------------------------------------*/
+#if _FS_WINCACHE && !_FS_READONLY
+static
+void cache_drop (	/* Forget the cached sectors of freed clusters */
+	FATFS *fs,		/* File system object */
+	DWORD clst,		/* Cluster# */
+	DWORD ncl		/* Number of clusters from clst */
+)
+{
+	DWORD sect = clust2sect(fs, clst);
+	int i;
+
+
+	for (i = 0; i < _FS_WINCACHE; i++) {
+		if (fs->wc_sect[i] - sect < ncl * fs->csize) {
+			fs->wc_sect[i] = 0xFFFFFFFF;
+			fs->wc_dirty[i] = 0;
+		}
+	}
+}
+#endif
+
+
 #if !_FS_READONLY
 static
 FRESULT remove_chain (
@@ -951,7 +1332,8 @@ FRESULT remove_chain (
 )
 {
 	FRESULT res;
-	DWORD nxt;
+	DWORD nxt, epb;
+	UINT i, n;
 #if _USE_ERASE
 	DWORD scl = clst, ecl = clst, rt[2];
 #endif
@@ -961,13 +1343,44 @@ FRESULT remove_chain (
 
 	} else {
 		res = FR_OK;
+		epb = SS(fs) / (fs->fs_type == FS_FAT32 ? 4 : 2);	/* FAT entries per sector (FAT16/32) */
 		while (clst < fs->n_fatent) {			/* Not a last link? */
+			if (fs->fs_type != FS_FAT12) {		/* Free the clusters linked to their successors at once */
+				res = move_window(fs, fs->fatbase + clst / epb);
+				if (res != FR_OK) break;
+				STAT_INC(fs, fat_scan);
+				i = (UINT)(clst % epb);
+				nxt = (fs->n_fatent - clst < epb - i) ? i + fs->n_fatent - clst : epb;	/* End of the entries in the volume */
+				n = fat_run(fs->win, i, (UINT)nxt, clst, fs->fs_type);
+				if (n) {
+					fat_clear(fs->win, i, n, fs->fs_type);
+					fs->wflag = 1;
+#if _FS_FREEMAP
+					for (nxt = clst; nxt < clst + n; nxt++) fmap_mark(fs, nxt, 0);
+#endif
+#if _FS_WINCACHE
+					cache_drop(fs, clst, n);
+#endif
+					if (fs->free_clust != 0xFFFFFFFF) {	/* Update FSInfo */
+						fs->free_clust += n;
+						fs->fsi_flag = 1;
+					}
+					clst += n;
+#if _USE_ERASE
+					ecl = clst;
+#endif
+					if (i + n == epb || clst >= fs->n_fatent) continue;	/* The run goes on in the next sector */
+				}
+			}
 			nxt = get_fat(fs, clst);			/* Get cluster status */
 			if (nxt == 0) break;				/* Empty cluster? */
 			if (nxt == 1) { res = FR_INT_ERR; break; }	/* Internal error? */
 			if (nxt == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }	/* Disk error? */
 			res = put_fat(fs, clst, 0);			/* Mark the cluster "empty" */
 			if (res != FR_OK) break;
+#if _FS_WINCACHE
+			cache_drop(fs, clst, 1);			/* Cached sectors of it are now garbage */
+#endif
 			if (fs->free_clust != 0xFFFFFFFF) {	/* Update FSInfo */
 				fs->free_clust++;
 				fs->fsi_flag = 1;
@@ -996,6 +1409,80 @@ FRESULT remove_chain (
 /*-----------------------------------------------------------------------*/
 /* FAT handling - Stretch or Create a cluster chain                      */
 /*-----------------------------------------------------------------------*/
+#if !_FS_READONLY
+static
+DWORD find_zero (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk error, >=2:Free cluster# */
+	FATFS *fs,		/* File system object */
+	DWORD clst,		/* First cluster to be checked (>=2) */
+	DWORD ecl		/* End of the clusters to be checked */
+)
+{
+	DWORD cs, epb, n;
+	UINT i;
+
+
+	if (fs->fs_type == FS_FAT12) {		/* Entry by entry */
+		for ( ; clst < ecl; clst++) {
+			cs = get_fat(fs, clst);
+			if (cs == 0) return clst;
+			if (cs == 0xFFFFFFFF || cs == 1) return cs;
+		}
+		return 0;
+	}
+	epb = SS(fs) / (fs->fs_type == FS_FAT32 ? 4 : 2);	/* Sector by sector */
+	while (clst < ecl) {
+		if (move_window(fs, fs->fatbase + clst / epb) != FR_OK) return 0xFFFFFFFF;
+		STAT_INC(fs, fat_scan);
+		i = (UINT)(clst % epb);
+		n = (ecl - clst < epb - i) ? i + ecl - clst : epb;	/* End of the entries to check in this sector */
+		i = fat_find0(fs->win, i, (UINT)n, fs->fs_type);
+		if (i < n) return clst - clst % epb + i;	/* Found a free cluster */
+		clst += n - clst % epb;
+	}
+	return 0;
+}
+#endif
+
+
+#if _FS_FREEMAP
+static
+DWORD find_free (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk error, >=2:Free cluster# */
+	FATFS *fs,		/* File system object */
+	DWORD scl		/* The search starts next to this cluster */
+)
+{
+	DWORD ncl, gcl, ecl, m, w;
+	BYTE wrap = 0;
+
+
+	ncl = scl + 1;
+	for (;;) {
+		if (ncl >= fs->n_fatent) {		/* Wrap around */
+			if (wrap || scl < 2) return 0;
+			ncl = 2; wrap = 1;
+		}
+		if (wrap && ncl > scl) return 0;	/* Came back to the start point */
+		m = ncl >> fs->fm_shift;
+		w = fs->fmap[m / 32];
+		if (!(w & (1UL << (m % 32)))) {	/* No free cluster in this group: skip it (or the whole map word) */
+			ncl = ((w ? m : (m | 31)) + 1) << fs->fm_shift;
+			continue;
+		}
+		gcl = m << fs->fm_shift;		/* Top of the group */
+		ecl = gcl + (1UL << fs->fm_shift);	/* End of the group */
+		if (ecl > fs->n_fatent) ecl = fs->n_fatent;
+		if (wrap && ecl > scl + 1) ecl = scl + 1;
+		w = find_zero(fs, ncl, ecl);	/* Search the group on the FAT */
+		if (w) return w;				/* Found a free cluster or an error occurred */
+		if ((ncl == gcl || (gcl < 2 && ncl == 2)) &&	/* The whole group has no free cluster */
+			(ecl == fs->n_fatent || !(ecl & ((1UL << fs->fm_shift) - 1))))
+			fs->fmap[m / 32] &= ~(1UL << (m % 32));
+		ncl = ecl;
+	}
+}
+#endif
+
+
 #if !_FS_READONLY
 static
 DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk error, >=2:New cluster# */
@@ -1018,19 +1505,13 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 		scl = clst;
 	}
 
-	ncl = scl;				/* Start cluster */
-	for (;;) {
-		ncl++;							/* Next cluster */
-		if (ncl >= fs->n_fatent) {		/* Wrap around */
-			ncl = 2;
-			if (ncl > scl) return 0;	/* No free cluster */
-		}
-		cs = get_fat(fs, ncl);			/* Get the cluster status */
-		if (cs == 0) break;				/* Found a free cluster */
-		if (cs == 0xFFFFFFFF || cs == 1)/* An error occurred */
-			return cs;
-		if (ncl == scl) return 0;		/* No free cluster */
-	}
+#if _FS_FREEMAP
+	ncl = find_free(fs, scl);		/* Look up the free map */
+#else
+	ncl = find_zero(fs, scl + 1, fs->n_fatent);		/* Search from the start point to the end */
+	if (ncl == 0) ncl = find_zero(fs, 2, scl + 1);	/* and wrap around */
+#endif
+	if (ncl < 2 || ncl == 0xFFFFFFFF) return ncl;	/* No free cluster or an error occurred */
 
 	res = put_fat(fs, ncl, 0x0FFFFFFF);	/* Mark the new cluster "last link" */
 	if (res == FR_OK && clst != 0) {
@@ -1080,6 +1561,293 @@ DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* File handling - Sectors in a run from the current cluster             */
+/*-----------------------------------------------------------------------*/
+
+#if _USE_EXPAND && !_FS_READONLY
+static
+UINT cont_span (	/* Number of sectors that can be transferred in a run from the top of the current cluster */
+	FIL* fp			/* Pointer to the file object (fptr on a sector boundary) */
+)
+{
+	DWORD bcs, n = 1;
+
+
+	if (fp->cont && fp->fptr < fp->fsize) {	/* Clusters up to the file size follow the current one */
+		bcs = (DWORD)fp->fs->csize * SS(fp->fs);
+		n = (fp->fsize - 1) / bcs - fp->fptr / bcs + 1;
+		if (n > 255U / fp->fs->csize) n = 255U / fp->fs->csize;	/* Clip at the disk_read/disk_write count */
+	}
+	return (UINT)n * fp->fs->csize;
+}
+#endif
+
+
+
+/*-----------------------------------------------------------------------*/
+/* File handling - Extent cache                                          */
+/*-----------------------------------------------------------------------*/
+
+#if _FS_EXTCACHE
+static
+UINT xc_find (	/* Number of runs starting at or before icl (the last of them is xc[n - 1]) */
+	FIL* fp,	/* Pointer to the file object */
+	DWORD icl	/* Cluster index in the file */
+)
+{
+	UINT lo = 0, hi = fp->xc_n, mid;
+
+
+	while (lo < hi) {		/* Binary search on the sorted run tops */
+		mid = (lo + hi) / 2;
+		if (fp->xc[mid].icl <= icl) lo = mid + 1; else hi = mid;
+	}
+	return lo;
+}
+
+
+static
+DWORD xc_lookup (	/* 0:Nothing known, >=2:Cluster# of the nearest known cluster at or before icl */
+	FIL* fp,		/* Pointer to the file object */
+	DWORD icl,		/* Cluster index in the file */
+	DWORD* kicl		/* Cluster index of the returned cluster */
+)
+{
+	FEXTENT *xp;
+	UINT i;
+
+
+	i = xc_find(fp, icl);
+	if (!i) return 0;
+	xp = &fp->xc[i - 1];
+	*kicl = (icl - xp->icl < xp->ncl) ? icl : xp->icl + xp->ncl - 1;	/* In the run or its last cluster */
+	return xp->clst + (*kicl - xp->icl);
+}
+
+
+static
+DWORD xc_clust (	/* 0:Not known, >=2:Cluster# of the cluster icl */
+	FIL* fp,		/* Pointer to the file object */
+	DWORD icl		/* Cluster index in the file */
+)
+{
+	DWORD kicl, clst;
+
+
+	clst = xc_lookup(fp, icl, &kicl);
+	return (clst && kicl == icl) ? clst : 0;
+}
+
+
+static
+void xc_remove (
+	FIL* fp,	/* Pointer to the file object */
+	UINT i		/* Run to be removed */
+)
+{
+	for (fp->xc_n--; i < fp->xc_n; i++) fp->xc[i] = fp->xc[i + 1];
+}
+
+
+static
+void xc_put (
+	FIL* fp,	/* Pointer to the file object */
+	DWORD icl,	/* Cluster index in the file */
+	DWORD clst	/* Cluster# it is mapped to */
+)
+{
+	FEXTENT *xp;
+	UINT i, j;
+
+
+	i = xc_find(fp, icl);
+	if (i) {
+		xp = &fp->xc[i - 1];
+		if (icl - xp->icl < xp->ncl) return;	/* Already known */
+		if (icl == xp->icl + xp->ncl && clst == xp->clst + xp->ncl) {	/* Stretches the run */
+			xp->ncl++;
+			if (i < fp->xc_n && fp->xc[i].icl == icl + 1 && fp->xc[i].clst == clst + 1) {	/* Joins the next run */
+				xp->ncl += fp->xc[i].ncl;
+				xc_remove(fp, i);
+			}
+			return;
+		}
+	}
+	if (i < fp->xc_n && fp->xc[i].icl == icl + 1 && fp->xc[i].clst == clst + 1) {	/* Heads the next run */
+		fp->xc[i].icl--; fp->xc[i].clst--; fp->xc[i].ncl++;
+		return;
+	}
+	if (fp->xc_n == _FS_EXTCACHE) {		/* Full: drop the shortest run */
+		for (j = 0, xp = &fp->xc[0]; j < fp->xc_n; j++) {
+			if (fp->xc[j].ncl < xp->ncl) xp = &fp->xc[j];
+		}
+		j = (UINT)(xp - fp->xc);
+		xc_remove(fp, j);
+		if (j < i) i--;
+	}
+	for (j = fp->xc_n++; j > i; j--) fp->xc[j] = fp->xc[j - 1];	/* Insert a new run */
+	fp->xc[i].icl = icl; fp->xc[i].clst = clst; fp->xc[i].ncl = 1;
+}
+
+
+#if !_FS_READONLY && _FS_MINIMIZE == 0
+static
+void xc_trim (
+	FIL* fp,	/* Pointer to the file object */
+	DWORD ncl	/* Number of clusters left in the file */
+)
+{
+	UINT i;
+
+
+	i = xc_find(fp, ncl);				/* Runs starting at or before ncl */
+	if (i && fp->xc[i - 1].icl == ncl) i--;	/* Drop the one starting at ncl too */
+	fp->xc_n = i;
+	if (i && fp->xc[i - 1].icl + fp->xc[i - 1].ncl > ncl)	/* Cut the last run at the file end */
+		fp->xc[i - 1].ncl = ncl - fp->xc[i - 1].icl;
+}
+#endif
+#endif	/* _FS_EXTCACHE */
+
+
+
+/*-----------------------------------------------------------------------*/
+/* File handling - Tail cache                                            */
+/*-----------------------------------------------------------------------*/
+
+#if _FS_TAILCACHE && !_FS_READONLY
+static
+UINT tail_find (	/* Index of the entry of the file (_FS_TAILCACHE:Not found) */
+	FATFS* fs,		/* File system object */
+	DWORD sect,		/* Sector containing the directory entry */
+	const BYTE* dir	/* Pointer to the directory entry in the win[] */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < _FS_TAILCACHE; i++) {
+		if (fs->tail[i].dir_sect == sect && fs->tail[i].dir_ofs == (UINT)(dir - fs->win)) break;
+	}
+	return i;
+}
+
+
+static
+void tail_drop (	/* Forget the tail of a file */
+	FATFS* fs,		/* File system object */
+	DWORD sect,		/* Sector containing the directory entry */
+	const BYTE* dir	/* Pointer to the directory entry in the win[] */
+)
+{
+	UINT i;
+
+
+	i = tail_find(fs, sect, dir);
+	if (i < _FS_TAILCACHE) {
+		for ( ; i + 1 < _FS_TAILCACHE; i++) fs->tail[i] = fs->tail[i + 1];
+		fs->tail[i].dir_sect = 0;
+	}
+}
+
+
+static
+void tail_put (	/* Remember the tail of a file just synchronized */
+	FIL* fp		/* Pointer to the file object */
+)
+{
+	FATFS *fs = fp->fs;
+	FTAIL *tp;
+	DWORD sect;
+	UINT i;
+
+
+	tail_drop(fs, fp->dir_sect, fp->dir_ptr);
+	if (!fp->fsize || fp->fptr != fp->fsize) return;	/* Tail is known only at the end of file */
+	for (i = _FS_TAILCACHE - 1; i; i--) fs->tail[i] = fs->tail[i - 1];	/* Push out the oldest one */
+	tp = &fs->tail[0];
+	tp->dir_sect = fp->dir_sect;
+	tp->dir_ofs = (UINT)(fp->dir_ptr - fs->win);
+	tp->sclust = fp->sclust;
+	tp->fsize = fp->fsize;
+	tp->clust = fp->clust;
+	tp->dsect = 0;
+	if (fp->fsize % SS(fs)) {		/* Keep the partial last sector if the file buffer holds it */
+		sect = clust2sect(fs, fp->clust);
+		if (sect) sect += (fp->fsize - 1) / SS(fs) & (fs->csize - 1);
+		if (sect && sect == fp->dsect) {
+			mem_cpy(tp->buf, fp->buf, SS(fs));
+			tp->dsect = sect;
+		}
+	}
+}
+#endif	/* _FS_TAILCACHE && !_FS_READONLY */
+
+
+
+/*-----------------------------------------------------------------------*/
+/* File handling - Move to the end of a just opened file                 */
+/*-----------------------------------------------------------------------*/
+
+#if !_FS_READONLY
+static
+FRESULT seek_end (
+	FIL* fp		/* Pointer to the file object (fptr = 0) */
+)
+{
+	FATFS *fs = fp->fs;
+	DWORD clst, ofs, bcs, sect;
+#if _FS_TAILCACHE
+	FTAIL *tp = 0;
+	UINT i;
+#endif
+
+
+	if (!fp->fsize) return FR_OK;
+	bcs = (DWORD)fs->csize * SS(fs);		/* Cluster size (byte) */
+	clst = 0;
+#if _FS_TAILCACHE
+	i = tail_find(fs, fp->dir_sect, fp->dir_ptr);
+	if (i < _FS_TAILCACHE && fs->tail[i].sclust == fp->sclust && fs->tail[i].fsize == fp->fsize) {
+		tp = &fs->tail[i];					/* Same file state as it was left */
+		clst = tp->clust;
+	}
+#endif
+	if (!clst) {							/* Follow the cluster chain on the FAT */
+		clst = fp->sclust;
+		for (ofs = fp->fsize; ofs > bcs; ofs -= bcs) {
+			clst = get_fat(fs, clst);
+			if (clst == 0xFFFFFFFF) return FR_DISK_ERR;
+			if (clst <= 1 || clst >= fs->n_fatent) return FR_INT_ERR;
+		}
+	}
+	fp->clust = clst;
+	fp->fptr = fp->fsize;
+#if _FS_EXTCACHE
+	xc_put(fp, (fp->fsize - 1) / bcs, clst);
+#endif
+	if (fp->fsize % SS(fs)) {				/* Load the partial last sector */
+		sect = clust2sect(fs, clst);
+		if (!sect) return FR_INT_ERR;
+		sect += (fp->fsize - 1) / SS(fs) & (fs->csize - 1);
+#if !_FS_TINY	/* Tiny cfg moves the window to it on the next access */
+#if _FS_TAILCACHE
+		if (tp && tp->dsect == sect)		/* Copy of it is at hand */
+			mem_cpy(fp->buf, tp->buf, SS(fs));
+		else
+#endif
+		if (disk_read(fs->drv, fp->buf, sect, 1) != RES_OK)
+			return FR_DISK_ERR;
+#endif
+		fp->dsect = sect;
+	}
+	return FR_OK;
+}
+#endif
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Directory handling - Set directory index                              */
 /*-----------------------------------------------------------------------*/
@@ -1672,6 +2440,10 @@ FRESULT dir_remove (	/* FR_OK: Successful, FR_DISK_ERR: A disk error */
 	}
 #endif
 
+#if _FS_TAILCACHE
+	if (res == FR_OK) tail_drop(dj->fs, dj->sect, dj->dir);	/* The entry may be reused by another file */
+#endif
+
 	return res;
 }
 #endif /* !_FS_READONLY */
@@ -2059,6 +2831,69 @@ BYTE check_fs (	/* 0:FAT-VBR, 1:Any BR but not FAT, 2:Not a BR, 3:Disk error */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Count free clusters (and build the free map)                          */
+/*-----------------------------------------------------------------------*/
+#if !_FS_READONLY && (_FS_MINIMIZE == 0 || _FS_FREEMAP)
+static
+FRESULT scan_fat (	/* FR_OK(0): successful, !=0: any error occurred */
+	FATFS *fs		/* File system object */
+)
+{
+	FRESULT res = FR_OK;
+	DWORD n = 0, clst, sect, stat, epb;
+	UINT i, e;
+	BYTE fat;
+
+
+#if _FS_FREEMAP
+	mem_set(fs->fmap, 0, sizeof fs->fmap);
+#endif
+	fat = fs->fs_type;
+	if (fat == FS_FAT12) {
+		clst = 2;
+		do {
+			stat = get_fat(fs, clst);
+			if (stat == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }
+			if (stat == 1) { res = FR_INT_ERR; break; }
+			if (stat == 0) {
+				n++;
+#if _FS_FREEMAP
+				fmap_mark(fs, clst, 0);
+#endif
+			}
+		} while (++clst < fs->n_fatent);
+	} else {
+		epb = SS(fs) / (fat == FS_FAT32 ? 4 : 2);	/* FAT entries per sector */
+		sect = fs->fatbase;
+		for (clst = 0; clst < fs->n_fatent; clst += epb) {	/* Sector by sector */
+			res = move_window(fs, sect++);
+			if (res != FR_OK) break;
+			STAT_INC(fs, fat_scan);
+			e = (fs->n_fatent - clst < epb) ? (UINT)(fs->n_fatent - clst) : (UINT)epb;
+			i = clst ? 0 : 2;				/* Skip the reserved entries */
+#if _FS_FREEMAP
+			for (i = fat_find0(fs->win, i, e, fat); i < e; i = fat_find0(fs->win, i + 1, e, fat)) {
+				n++;
+				fmap_mark(fs, clst + i, 0);
+			}
+#else
+			n += fat_count0(fs->win, i, e, fat);
+#endif
+		}
+	}
+	if (res == FR_OK) {
+		if (fat == FS_FAT32 && fs->free_clust != n) fs->fsi_flag = 1;
+		fs->free_clust = n;
+	}
+
+	return res;
+}
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Check if the file system object is valid or not                       */
 /*-----------------------------------------------------------------------*/
@@ -2214,12 +3049,25 @@ FRESULT chk_mounted (	/* FR_OK(0): successful, !=0: any error occurred */
 	fs->id = ++Fsid;		/* File system mount ID */
 	fs->winsect = 0;		/* Invalidate sector cache */
 	fs->wflag = 0;
+#if _FS_WINCACHE
+	cache_reset(fs);
+#endif
+#if _FS_TAILCACHE && !_FS_READONLY
+	mem_set(fs->tail, 0, sizeof fs->tail);	/* Forget file tails */
+#endif
 #if _FS_RPATH
 	fs->cdir = 0;			/* Current directory (root dir) */
 #endif
 #if _FS_LOCK				/* Clear file lock semaphores */
 	clear_lock(fs);
 #endif
+#if _FS_FREEMAP				/* Build the free cluster map */
+	for (fs->fm_shift = 0; (fs->n_fatent - 1) >> fs->fm_shift >= sizeof fs->fmap * 8; fs->fm_shift++) ;
+	if (scan_fat(fs) != FR_OK) {
+		fs->fs_type = 0;
+		return FR_DISK_ERR;
+	}
+#endif
 
 	return FR_OK;
 }
@@ -2314,6 +3162,9 @@ FRESULT f_open (
 	FRESULT res;
 	DIR dj;
 	BYTE *dir;
+#if !_FS_READONLY
+	BYTE seekend;
+#endif
 	DEF_NAMEBUF;
 
 
@@ -2321,6 +3172,7 @@ FRESULT f_open (
 	fp->fs = 0;			/* Clear file object */
 
 #if !_FS_READONLY
+	seekend = mode & FA_OPEN_APPEND & ~FA_OPEN_ALWAYS;	/* FA_OPEN_APPEND: move to the end after opening */
 	mode &= FA_READ | FA_WRITE | FA_CREATE_ALWAYS | FA_OPEN_ALWAYS | FA_CREATE_NEW;
 	res = chk_mounted(&path, &dj.fs, (BYTE)(mode & ~FA_READ));
 #else
@@ -2370,6 +3222,9 @@ FRESULT f_open (
 				cl = ld_clust(dj.fs, dir);			/* Get start cluster */
 				st_clust(dir, 0);					/* cluster = 0 */
 				dj.fs->wflag = 1;
+#if _FS_TAILCACHE
+				tail_drop(dj.fs, dj.fs->winsect, dir);	/* Its tail is gone */
+#endif
 				if (cl) {							/* Remove the cluster chain if exist */
 					dw = dj.fs->winsect;
 					res = remove_chain(dj.fs, cl);
@@ -2422,8 +3277,25 @@ FRESULT f_open (
 			fp->dsect = 0;
 #if _USE_FASTSEEK
 			fp->cltbl = 0;						/* Normal seek mode */
+#endif
+#if _USE_EXPAND && !_FS_READONLY
+			fp->cont = 0;						/* Chain layout is unknown */
+#endif
+#if _FS_EXTCACHE
+			fp->xc_n = 0;						/* No cluster run known */
 #endif
 			fp->fs = dj.fs; fp->id = dj.fs->id;	/* Validate file object */
+#if !_FS_READONLY
+			if (seekend) {						/* Move to the end of the file */
+				res = seek_end(fp);
+				if (res != FR_OK) {
+#if _FS_LOCK
+					dec_lock(fp->lockid);
+#endif
+					fp->fs = 0;
+				}
+			}
+#endif
 		}
 	}
 
@@ -2473,22 +3345,41 @@ FRESULT f_read (
 					if (fp->cltbl)
 						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
 					else
+#endif
+#if _USE_EXPAND && !_FS_READONLY
+					if (fp->cont)
+						clst = fp->clust + 1;	/* Contiguous file: no FAT lookup */
+					else
+#endif
+#if _FS_EXTCACHE
+					if ((clst = xc_clust(fp, fp->fptr / SS(fp->fs) / fp->fs->csize)) == 0)	/* Not in the extent cache? */
 #endif
 						clst = get_fat(fp->fs, fp->clust);	/* Follow cluster chain on the FAT */
 				}
 				if (clst < 2) ABORT(fp->fs, FR_INT_ERR);
 				if (clst == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
 				fp->clust = clst;				/* Update current cluster */
+#if _FS_EXTCACHE
+				xc_put(fp, fp->fptr / SS(fp->fs) / fp->fs->csize, clst);
+#endif
 			}
 			sect = clust2sect(fp->fs, fp->clust);	/* Get current sector */
 			if (!sect) ABORT(fp->fs, FR_INT_ERR);
 			sect += csect;
 			cc = btr / SS(fp->fs);				/* When remaining bytes >= sector size, */
 			if (cc) {							/* Read maximum contiguous sectors directly */
+#if _USE_EXPAND && !_FS_READONLY
+				if (csect + cc > cont_span(fp))	/* Clip at cluster boundary or end of the contiguous run */
+					cc = cont_span(fp) - csect;
+#else
 				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
 					cc = fp->fs->csize - csect;
+#endif
 				if (disk_read(fp->fs->drv, rbuff, sect, (BYTE)cc) != RES_OK)
 					ABORT(fp->fs, FR_DISK_ERR);
+#if _USE_EXPAND && !_FS_READONLY
+				fp->clust += (csect + cc - 1) / fp->fs->csize;	/* Cluster of the last sector read */
+#endif
 #if !_FS_READONLY && _FS_MINIMIZE <= 2			/* Replace one of the read sectors with cached data if it contains a dirty sector */
 #if _FS_TINY
 				if (fp->fs->wflag && fp->fs->winsect - sect < cc)
@@ -2576,13 +3467,27 @@ FRESULT f_write (
 					if (fp->cltbl)
 						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
 					else
+#endif
+#if _USE_EXPAND
+					if (fp->cont && fp->fptr < fp->fsize)
+						clst = fp->clust + 1;	/* Contiguous file: no FAT lookup */
+					else
+#endif
+#if _FS_EXTCACHE
+					if ((clst = xc_clust(fp, fp->fptr / SS(fp->fs) / fp->fs->csize)) == 0)	/* Not in the extent cache? */
 #endif
 						clst = create_chain(fp->fs, fp->clust);	/* Follow or stretch cluster chain on the FAT */
 				}
 				if (clst == 0) break;		/* Could not allocate a new cluster (disk full) */
 				if (clst == 1) ABORT(fp->fs, FR_INT_ERR);
 				if (clst == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
+#if _USE_EXPAND
+				if (fp->fptr && clst != fp->clust + 1) fp->cont = 0;	/* The chain got fragmented */
+#endif
 				fp->clust = clst;			/* Update current cluster */
+#if _FS_EXTCACHE
+				xc_put(fp, fp->fptr / SS(fp->fs) / fp->fs->csize, clst);
+#endif
 			}
 #if _FS_TINY
 			if (fp->fs->winsect == fp->dsect && sync_window(fp->fs))	/* Write-back sector cache */
@@ -2599,10 +3504,18 @@ FRESULT f_write (
 			sect += csect;
 			cc = btw / SS(fp->fs);			/* When remaining bytes >= sector size, */
 			if (cc) {						/* Write maximum contiguous sectors directly */
+#if _USE_EXPAND
+				if (csect + cc > cont_span(fp))	/* Clip at cluster boundary or end of the contiguous run */
+					cc = cont_span(fp) - csect;
+#else
 				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
 					cc = fp->fs->csize - csect;
+#endif
 				if (disk_write(fp->fs->drv, wbuff, sect, (BYTE)cc) != RES_OK)
 					ABORT(fp->fs, FR_DISK_ERR);
+#if _USE_EXPAND
+				fp->clust += (csect + cc - 1) / fp->fs->csize;	/* Cluster of the last sector written */
+#endif
 #if _FS_TINY
 				if (fp->fs->winsect - sect < cc) {	/* Refill sector cache if it gets invalidated by the direct write */
 					mem_cpy(fp->fs->win, wbuff + ((fp->fs->winsect - sect) * SS(fp->fs)), SS(fp->fs));
@@ -2688,6 +3601,9 @@ FRESULT f_sync (
 				ST_WORD(dir+DIR_LstAccDate, 0);
 				fp->flag &= ~FA__WRITTEN;
 				fp->fs->wflag = 1;
+#if _FS_TAILCACHE
+				tail_put(fp);
+#endif
 				res = sync_fs(fp->fs);
 			}
 		}
@@ -2976,6 +3892,30 @@ FRESULT f_lseek (
 				fp->clust = clst;
 			}
 			if (clst != 0) {
+#if _USE_EXPAND && !_FS_READONLY
+				if (fp->cont && fp->fptr < fp->fsize) {	/* Contiguous file: jump over the allocated clusters */
+					nsect = (ofs - 1) / bcs;
+					if (nsect > (fp->fsize - 1) / bcs - fp->fptr / bcs)
+						nsect = (fp->fsize - 1) / bcs - fp->fptr / bcs;
+					clst += nsect;
+					fp->clust = clst;
+					fp->fptr += nsect * bcs;
+					ofs -= nsect * bcs;
+					nsect = 0;
+				}
+#endif
+#if _FS_EXTCACHE
+				if (ofs > bcs) {						/* Start from a cached cluster nearer to the target */
+					clst = xc_lookup(fp, (fp->fptr + ofs - 1) / bcs, &nsect);
+					if (clst && nsect * bcs > fp->fptr) {
+						ofs -= nsect * bcs - fp->fptr;
+						fp->fptr = nsect * bcs;
+						fp->clust = clst;
+					}
+					clst = fp->clust;
+					nsect = 0;
+				}
+#endif
 				while (ofs > bcs) {						/* Cluster following loop */
 #if !_FS_READONLY
 					if (fp->flag & FA_WRITE) {			/* Check if in write mode or not */
@@ -2988,8 +3928,14 @@ FRESULT f_lseek (
 						clst = get_fat(fp->fs, clst);	/* Follow cluster chain if not in write mode */
 					if (clst == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
 					if (clst <= 1 || clst >= fp->fs->n_fatent) ABORT(fp->fs, FR_INT_ERR);
+#if _USE_EXPAND && !_FS_READONLY
+					if (clst != fp->clust + 1) fp->cont = 0;	/* The chain got fragmented */
+#endif
 					fp->clust = clst;
 					fp->fptr += bcs;
+#if _FS_EXTCACHE
+					xc_put(fp, fp->fptr / bcs, clst);
+#endif
 					ofs -= bcs;
 				}
 				fp->fptr += ofs;
@@ -3162,9 +4108,6 @@ FRESULT f_getfree (
 {
 	FRESULT res;
 	FATFS *fs;
-	DWORD n, clst, sect, stat;
-	UINT i;
-	BYTE fat, *p;
 
 
 	/* Get drive number */
@@ -3176,39 +4119,8 @@ FRESULT f_getfree (
 			*nclst = fs->free_clust;
 		} else {
 			/* Get number of free clusters */
-			fat = fs->fs_type;
-			n = 0;
-			if (fat == FS_FAT12) {
-				clst = 2;
-				do {
-					stat = get_fat(fs, clst);
-					if (stat == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }
-					if (stat == 1) { res = FR_INT_ERR; break; }
-					if (stat == 0) n++;
-				} while (++clst < fs->n_fatent);
-			} else {
-				clst = fs->n_fatent;
-				sect = fs->fatbase;
-				i = 0; p = 0;
-				do {
-					if (!i) {
-						res = move_window(fs, sect++);
-						if (res != FR_OK) break;
-						p = fs->win;
-						i = SS(fs);
-					}
-					if (fat == FS_FAT16) {
-						if (LD_WORD(p) == 0) n++;
-						p += 2; i -= 2;
-					} else {
-						if ((LD_DWORD(p) & 0x0FFFFFFF) == 0) n++;
-						p += 4; i -= 4;
-					}
-				} while (--clst);
-			}
-			fs->free_clust = n;
-			if (fat == FS_FAT32) fs->fsi_flag = 1;
-			*nclst = n;
+			res = scan_fat(fs);
+			*nclst = fs->free_clust;
 		}
 	}
 	LEAVE_FF(fs, res);
@@ -3242,6 +4154,9 @@ FRESULT f_truncate (
 		if (fp->fsize > fp->fptr) {
 			fp->fsize = fp->fptr;	/* Set file size to current R/W point */
 			fp->flag |= FA__WRITTEN;
+#if _FS_EXTCACHE
+			xc_trim(fp, fp->fptr ? (fp->fptr - 1) / SS(fp->fs) / fp->fs->csize + 1 : 0);	/* Forget the removed clusters */
+#endif
 			if (fp->fptr == 0) {	/* When set file size to zero, remove entire cluster chain */
 				res = remove_chain(fp->fs, fp->sclust);
 				fp->sclust = 0;
@@ -3729,6 +4644,90 @@ FRESULT f_setlabel (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Allocate a Contiguous Block to the File                               */
+/*-----------------------------------------------------------------------*/
+#if _USE_EXPAND && !_FS_READONLY
+
+FRESULT f_expand (
+	FIL *fp,		/* Pointer to the file object */
+	DWORD fsz,		/* File size to be expanded to */
+	BYTE opt		/* Operation mode 0:Find and prepare or 1:Find and allocate */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DWORD n, clst, stcl, scl, ncl, tcl;
+	BYTE lap = 0;
+
+
+	res = validate(fp);						/* Check validity of the object */
+	if (res != FR_OK) LEAVE_FF(fp->fs, res);
+	if (fp->flag & FA__ERROR)				/* Check abort flag */
+		LEAVE_FF(fp->fs, FR_INT_ERR);
+	if (fsz == 0 || fp->fsize != 0 || !(fp->flag & FA_WRITE))	/* Only an empty file opened for write */
+		LEAVE_FF(fp->fs, FR_DENIED);
+	fs = fp->fs;
+	n = (DWORD)fs->csize * SS(fs);			/* Cluster size */
+	tcl = (fsz - 1) / n + 1;				/* Number of clusters required */
+	if (tcl > fs->n_fatent - 2) LEAVE_FF(fs, FR_DENIED);
+
+	/* Find a run of tcl free clusters, starting at the allocation hint */
+	stcl = fs->last_clust;
+	if (stcl < 2 || stcl >= fs->n_fatent) stcl = 2;
+	scl = clst = stcl; ncl = 0;
+	for (;;) {
+		n = get_fat(fs, clst);				/* Get the cluster status */
+		if (n == 1) { res = FR_INT_ERR; break; }
+		if (n == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }
+		if (++clst >= fs->n_fatent) {		/* Wrap around: a run cannot cross the end */
+			clst = 2;
+			if (n == 0 && ++ncl == tcl) break;
+			scl = 2; ncl = 0;
+		} else {
+			if (n == 0) {					/* Free cluster */
+				if (++ncl == tcl) break;	/* Found the run */
+			} else {						/* Used cluster: restart the run at the next one */
+				scl = clst; ncl = 0;
+			}
+		}
+		if (clst == stcl) lap = 1;			/* Back at the hint: finish only the run under way */
+		if (lap && ncl == 0) { res = FR_DENIED; break; }	/* No contiguous space */
+	}
+
+	if (res == FR_OK) {
+		if (opt) {							/* Link the clusters in one pass over the FAT */
+			for (clst = scl, n = scl + tcl - 1; res == FR_OK && clst < n; clst++)
+				res = put_fat(fs, clst, clst + 1);
+			if (res == FR_OK) res = put_fat(fs, n, 0x0FFFFFFF);
+			if (res == FR_OK) {
+				fs->last_clust = n;
+				if (fs->free_clust != 0xFFFFFFFF) {	/* Update FSInfo */
+					fs->free_clust -= tcl;
+					fs->fsi_flag = 1;
+				}
+				fp->sclust = scl;			/* The file now owns the block */
+				fp->fsize = fsz;
+				fp->flag |= FA__WRITTEN;
+#if _FS_EXTCACHE
+				fp->xc[0].icl = 0; fp->xc[0].clst = scl; fp->xc[0].ncl = tcl;
+				fp->xc_n = 1;
+#endif
+			}
+		} else {							/* Have the next allocation start at the block. Nothing */
+			fs->last_clust = scl - 1;		/* is reserved: another file may take it first, and then */
+		}									/* f_write clears cont when the chain breaks */
+		if (res == FR_OK) fp->cont = 1;		/* Reads and writes may skip the FAT */
+		else fp->flag |= FA__ERROR;
+	}
+
+	LEAVE_FF(fs, res);
+}
+
+#endif /* _USE_EXPAND && !_FS_READONLY */
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Forward data to the stream directly (available on only tiny cfg)      */
 /*-----------------------------------------------------------------------*/
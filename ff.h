@@ -72,6 +72,50 @@ typedef char TCHAR;
 
 
 
+/* Access counters of a file system object (_FS_STATS) */
+
+#if _FS_STATS
+typedef struct {
+	DWORD	win_hit;		/* move_window() calls served by win[] */
+	DWORD	win_miss;		/* move_window() calls that read a sector */
+	DWORD	win_cached;		/* move_window() calls served by the sector cache */
+	DWORD	win_flush;		/* Dirty sector write-backs (FAT mirrors not counted) */
+	DWORD	fat_get;		/* get_fat() calls */
+	DWORD	fat_put;		/* put_fat() calls */
+	DWORD	fat_scan;		/* FAT sectors handed to the scanning kernels */
+} FFSTATS;
+#endif
+
+
+
+/* End of a recently written file (_FS_TAILCACHE) */
+
+#if _FS_TAILCACHE && !_FS_READONLY
+typedef struct {
+	DWORD	dir_sect;		/* Sector containing the directory entry (0:Empty) */
+	UINT	dir_ofs;		/* Offset of the directory entry in the sector */
+	DWORD	sclust;			/* File start cluster */
+	DWORD	fsize;			/* File size */
+	DWORD	clust;			/* Last cluster of the file */
+	DWORD	dsect;			/* Sector held in buf[] (0:None) */
+	BYTE	buf[_MAX_SS];	/* Partial last sector of the file */
+} FTAIL;
+#endif
+
+
+
+/* Run of contiguous clusters in a file (_FS_EXTCACHE) */
+
+#if _FS_EXTCACHE
+typedef struct {
+	DWORD	icl;			/* Cluster index in the file of the run top */
+	DWORD	clst;			/* Cluster# of the run top */
+	DWORD	ncl;			/* Number of clusters in the run */
+} FEXTENT;
+#endif
+
+
+
 /* File system object structure (FATFS) */
 
 typedef struct {
@@ -104,7 +148,24 @@ typedef struct {
 	DWORD	dirbase;		/* Root directory start sector (FAT32:Cluster#) */
 	DWORD	database;		/* Data start sector */
 	DWORD	winsect;		/* Current sector appearing in the win[] */
-	BYTE	win[_MAX_SS];	/* Disk access window for Directory, FAT (and Data on tiny cfg) */
+	BYTE	win[_MAX_SS];	/* Disk access window for Directory, FAT (and Data on tiny cfg), 4-byte aligned (checked in ff.c) */
+#if _FS_STATS
+	FFSTATS	stats;			/* Access counters */
+#endif
+#if _FS_TAILCACHE && !_FS_READONLY
+	FTAIL	tail[_FS_TAILCACHE];	/* File tails, most recent first */
+#endif
+#if _FS_FREEMAP
+	BYTE	fm_shift;		/* Clusters per free map bit (log2) */
+	DWORD	fmap[(_FS_FREEMAP + 3) / 4];	/* Free map (1:Cluster group may be free) */
+#endif
+#if _FS_WINCACHE
+	DWORD	wc_tick;		/* Sector cache access counter */
+	DWORD	wc_sect[_FS_WINCACHE];	/* Sector in each cache entry (0xFFFFFFFF:Empty) */
+	DWORD	wc_used[_FS_WINCACHE];	/* Last access of each entry (LRU) */
+	BYTE	wc_dirty[_FS_WINCACHE];	/* Dirty flag of each entry */
+	BYTE	wc_buf[_FS_WINCACHE][_MAX_SS];	/* Cached sectors */
+#endif
 } FATFS;
 
 
@@ -115,7 +176,11 @@ typedef struct {
 	FATFS*	fs;				/* Pointer to the related file system object (**do not change order**) */
 	WORD	id;				/* Owner file system mount ID (**do not change order**) */
 	BYTE	flag;			/* File status flags */
+#if _USE_EXPAND && !_FS_READONLY
+	BYTE	cont;			/* 1:Cluster chain is contiguous from sclust (f_expand) */
+#else
 	BYTE	pad1;
+#endif
 	DWORD	fptr;			/* File read/write pointer (0ed on file open) */
 	DWORD	fsize;			/* File size */
 	DWORD	sclust;			/* File data start cluster (0:no data cluster, always 0 when fsize is 0) */
@@ -128,6 +193,10 @@ typedef struct {
 #if _USE_FASTSEEK
 	DWORD*	cltbl;			/* Pointer to the cluster link map table (null on file open) */
 #endif
+#if _FS_EXTCACHE
+	UINT	xc_n;			/* Number of runs in xc[] */
+	FEXTENT	xc[_FS_EXTCACHE];	/* Known runs of the cluster chain, sorted by icl */
+#endif
 #if _FS_LOCK
 	UINT	lockid;			/* File lock ID (index of file semaphore table Files[]) */
 #endif
@@ -214,6 +283,7 @@ FRESULT f_stat (const TCHAR* path, FILINFO* fno);					/* Get file status */
 FRESULT f_write (FIL* fp, const void* buff, UINT btw, UINT* bw);	/* Write data to a file */
 FRESULT f_getfree (const TCHAR* path, DWORD* nclst, FATFS** fatfs);	/* Get number of free clusters on the drive */
 FRESULT f_truncate (FIL* fp);										/* Truncate file */
+FRESULT f_expand (FIL* fp, DWORD fsz, BYTE opt);					/* Allocate a contiguous block to the file */
 FRESULT f_sync (FIL* fp);											/* Flush cached data of a writing file */
 FRESULT f_unlink (const TCHAR* path);								/* Delete an existing file or directory */
 FRESULT	f_mkdir (const TCHAR* path);								/* Create a new directory */
@@ -289,6 +359,7 @@ int ff_del_syncobj (_SYNC_t sobj);				/* Delete a sync object */
 #define	FA_CREATE_NEW		0x04
 #define	FA_CREATE_ALWAYS	0x08
 #define	FA_OPEN_ALWAYS		0x10
+#define	FA_OPEN_APPEND		0x30	/* FA_OPEN_ALWAYS and move to the end of the file */
 #define FA__WRITTEN			0x20
 #define FA__DIRTY			0x40
 #endif
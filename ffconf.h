@@ -30,6 +30,49 @@
 /  data transfer. This reduces memory consumption 512 bytes each file object. */
 
 
+#ifndef _FS_WINCACHE
+#define	_FS_WINCACHE	0	/* 0:Disable or 1-255:Number of cached sectors */
+#endif
+/* _FS_WINCACHE keeps that many FAT/directory sectors behind the FATFS window,
+/  so get_fat, put_fat and the directory functions stop evicting each other.
+/  Dirty sectors are written back on eviction and, in sector order, on sync.
+/  Each entry adds _MAX_SS + 9 bytes to the file system object. It cannot be
+/  used with _FS_TINY. Sectors are loaded through the cache, so it takes at
+/  least 2 entries to keep one sector while another is in the window. */
+
+
+#ifndef _FS_EXTCACHE
+#define	_FS_EXTCACHE	0	/* 0:Disable or 1-255:Number of cluster runs cached per file */
+#endif
+/* _FS_EXTCACHE keeps that many runs of contiguous clusters in each file
+/  object as f_read, f_write and f_lseek follow the cluster chain. Crossing
+/  into a known cluster or seeking near one then skips the FAT walk from the
+/  top of the file. When the cache is full, the shortest run is dropped. Each
+/  entry adds 12 bytes to the file object. */
+
+
+#ifndef _FS_TAILCACHE
+#define	_FS_TAILCACHE	0	/* 0:Disable or 1-255:Number of file tails cached per volume */
+#endif
+/* _FS_TAILCACHE remembers the last cluster and the partial last sector of the
+/  files most recently written up to their end. Opening one of them again with
+/  FA_OPEN_APPEND then takes neither a walk of the cluster chain nor a sector
+/  read. Each entry adds _MAX_SS + 24 bytes to the file system object. It
+/  cannot be used with _FS_TINY. */
+
+
+#ifndef _FS_FREEMAP
+#define	_FS_FREEMAP		0	/* 0:Disable or >=4:Size of the free cluster map in bytes */
+#endif
+/* With _FS_FREEMAP set, mounting a volume scans the FAT once into a bitmap of
+/  that many bytes in the file system object. create_chain() then finds free
+/  clusters in RAM instead of walking the FAT, and f_getfree() returns at once.
+/  A bit covers one cluster if the map is large enough (number of clusters / 8
+/  bytes), else a power-of-2 group of clusters that may hold free ones, and
+/  only those groups are searched on the FAT. The mount reads the whole FAT
+/  (4 MB on a 32 GB card). Cannot be used with _FS_READONLY. */
+
+
 #define _FS_READONLY	0	/* 0:Read/Write or 1:Read only */
 /* Setting _FS_READONLY to 1 defines read only configuration. This removes
 /  writing functions, f_write, f_sync, f_unlink, f_mkdir, f_chmod, f_rename,
@@ -50,14 +93,28 @@
 /* To enable string functions, set _USE_STRFUNC to 1 or 2. */
 
 
+#ifdef ENABLE_MKFS
+#define	_USE_MKFS		1	/* 0:Disable or 1:Enable */
+#else
 #define	_USE_MKFS		0	/* 0:Disable or 1:Enable */
-/* To enable f_mkfs function, set _USE_MKFS to 1 and set _FS_READONLY to 0 */
+#endif
+/* To enable f_mkfs function, set _USE_MKFS to 1 and set _FS_READONLY to 0.
+/  Host builds that format their own images define ENABLE_MKFS. */
 
 
 #define	_USE_FASTSEEK	0	/* 0:Disable or 1:Enable */
 /* To enable fast seek feature, set _USE_FASTSEEK to 1. */
 
 
+#define	_USE_EXPAND		1	/* 0:Disable or 1:Enable */
+/* To enable f_expand function, set _USE_EXPAND to 1 and set _FS_READONLY to 0.
+/  A file given its clusters by f_expand is known to be contiguous while it is
+/  open, so f_read, f_write and f_lseek step through it without the FAT and
+/  transfer across cluster boundaries in one disk access. With opt 0, f_expand
+/  only points the next allocation at the block and reserves nothing; another
+/  file allocating first can take part of it. */
+
+
 #define _USE_LABEL		0	/* 0:Disable or 1:Enable */
 /* To enable volume label functions, set _USE_LAVEL to 1 */
 
@@ -140,8 +197,14 @@
 / Physical Drive Configurations
 /----------------------------------------------------------------------------*/
 
+#ifndef _VOLUMES
 #define _VOLUMES	1
-/* Number of volumes (logical drives) to be used. */
+#endif
+/* Number of volumes (logical drives) to be used. With _MULTI_PARTITION 0,
+/  volume n is physical drive n: drives 0 to SD_DRIVES-1 are the SD cards and,
+/  with SD_STRIPE set, drive SD_DRIVES is the striped drive (see diskio.h).
+/  A build with more cards sets _VOLUMES to SD_DRIVES + SD_STRIPE along with
+/  them, e.g. -DSD_DRIVES=4 -DSD_STRIPE=1 -D_VOLUMES=5. */
 
 
 #define	_MAX_SS		512		/* 512, 1024, 2048 or 4096 */
@@ -158,9 +221,14 @@
 / is tied to the partitions listed in VolToPart[]. */
 
 
+#ifndef _USE_ERASE
 #define	_USE_ERASE	0	/* 0:Disable or 1:Enable */
+#endif
 /* To enable sector erase feature, set _USE_ERASE to 1. CTRL_ERASE_SECTOR command
-/  should be added to the disk_ioctl functio. */
+/  should be added to the disk_ioctl functio. diskio.c has it for SDv2 and for
+/  SDv1 cards that erase by sector. With it, FatFs erases the clusters that a
+/  chain removal frees and f_mkfs erases the data area, which can take seconds
+/  on a large card. */
 
 
 
@@ -202,4 +270,14 @@
    The value defines how many files can be opened simultaneously. */
 
 
+#ifdef ENABLE_STATS
+#define	_FS_STATS	1
+#else
+#define	_FS_STATS	0	/* 0:Disable or 1:Enable */
+#endif
+/* When _FS_STATS is set to 1, each FATFS object counts its window and FAT
+/  accesses in its stats member (FFSTATS) for benchmarking. The counters are
+/  never reset by FatFs; clear them with mem_set/memset as needed. */
+
+
 #endif /* _FFCONFIG */
@@ -0,0 +1,275 @@
+//*****************************************************************************
+//
+// diskio_posix.c - FatFs disk I/O layer over image files on a POSIX host.
+//
+// Stands in for diskio.c when ff.c is built for Linux (or another POSIX
+// host): each physical drive is an image file attached with
+// disk_posix_attach(), read and written with pread()/pwrite() or through a
+// shared mapping. Sparse images work, so a 32 GB volume costs only the
+// clusters actually used. The asynchronous calls complete synchronously.
+// get_fattime() returns the host's local time.
+//
+// Build (from the repository root):
+//   gcc -O2 -I. -o fstest app.c ff.c host/diskio_posix.c
+//
+// where app.c attaches an image and uses the FatFs API. Images can be made
+// with e.g. "truncate -s 32G sd.img && mkfs.vfat -F 32 sd.img".
+//
+//*****************************************************************************
+
+#define _FILE_OFFSET_BITS 64
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "host/diskio_posix.h"
+
+#define SECTOR_SIZE     512
+
+// ----------------------- Drive state -----------------------
+typedef struct
+{
+    int         fd;                 // -1 when no image is attached
+    uint32_t    flags;
+    uint64_t    sectors;
+    uint8_t*    map;                // DISK_POSIX_MMAP only
+    size_t      map_len;
+    DSTATUS     stat;
+    DISK_POSIX_STATS st;
+}
+IMAGE;
+
+static IMAGE Images[_VOLUMES];
+static bool Images_init;
+
+static IMAGE* image_get(BYTE drv)
+{
+    int i;
+
+    if (!Images_init) {
+        for (i = 0; i < _VOLUMES; i++) {
+            Images[i].fd = -1;
+            Images[i].stat = STA_NOINIT | STA_NODISK;
+        }
+        Images_init = true;
+    }
+    return (drv < _VOLUMES) ? &Images[drv] : 0;
+}
+
+// Copy count sectors between the image and buff. Returns RES_OK or RES_ERROR.
+static DRESULT image_io(IMAGE* im, BYTE* buff, DWORD sector, UINT count, bool wr)
+{
+    off_t off = (off_t)sector * SECTOR_SIZE;
+    size_t len = (size_t)count * SECTOR_SIZE;
+    ssize_t n;
+
+    if ((uint64_t)sector + count > im->sectors) return RES_PARERR;
+    if (im->map) {
+        if (wr) memcpy(im->map + off, buff, len);
+        else memcpy(buff, im->map + off, len);
+        return RES_OK;
+    }
+    while (len) {
+        n = wr ? pwrite(im->fd, buff, len, off) : pread(im->fd, buff, len, off);
+        if (n <= 0) return RES_ERROR;
+        buff += n; off += n; len -= (size_t)n;
+    }
+    return RES_OK;
+}
+
+static DRESULT image_read(BYTE drv, BYTE* buff, DWORD sector, BYTE count, bool meta)
+{
+    IMAGE* im = image_get(drv);
+
+    if (!im || !count) return RES_PARERR;
+    if (im->stat & STA_NOINIT) return RES_NOTRDY;
+    im->st.reads++;
+    if (meta) im->st.meta_reads++;
+    im->st.sectors_read += count;
+    return image_io(im, buff, sector, count, false);
+}
+
+static DRESULT image_write(BYTE drv, const BYTE* buff, DWORD sector, BYTE count, bool meta)
+{
+    IMAGE* im = image_get(drv);
+
+    if (!im || !count) return RES_PARERR;
+    if (im->stat & STA_NOINIT) return RES_NOTRDY;
+    if (im->stat & STA_PROTECT) return RES_WRPRT;
+    im->st.writes++;
+    if (meta) im->st.meta_writes++;
+    im->st.sectors_written += count;
+    return image_io(im, (BYTE*)buff, sector, count, true);
+}
+
+// ----------------------- Image attachment -----------------------
+// Attach an image file to a drive. The file size is rounded down to whole
+// sectors. Returns 0, or -1 with errno set.
+int disk_posix_attach(uint8_t drv, const char* path, uint32_t flags)
+{
+    IMAGE* im = image_get(drv);
+    struct stat sb;
+    int fd;
+
+    if (!im) return -1;
+    disk_posix_detach(drv);
+    fd = open(path, (flags & DISK_POSIX_RDONLY) ? O_RDONLY : O_RDWR);
+    if (fd < 0) return -1;
+    if (fstat(fd, &sb)) { close(fd); return -1; }
+    im->sectors = (uint64_t)sb.st_size / SECTOR_SIZE;
+    if (im->sectors > 0xFFFFFFFF) im->sectors = 0xFFFFFFFF;
+    if ((flags & DISK_POSIX_MMAP) && im->sectors) {
+        im->map_len = (size_t)(im->sectors * SECTOR_SIZE);
+        im->map = mmap(0, im->map_len,
+                       PROT_READ | ((flags & DISK_POSIX_RDONLY) ? 0 : PROT_WRITE),
+                       MAP_SHARED, fd, 0);
+        if (im->map == MAP_FAILED) { im->map = 0; close(fd); return -1; }
+    }
+    im->fd = fd;
+    im->flags = flags;
+    im->stat = STA_NOINIT | ((flags & DISK_POSIX_RDONLY) ? STA_PROTECT : 0);
+    memset(&im->st, 0, sizeof(im->st));
+    return 0;
+}
+
+void disk_posix_detach(uint8_t drv)
+{
+    IMAGE* im = image_get(drv);
+
+    if (!im || im->fd < 0) return;
+    if (im->map) munmap(im->map, im->map_len);
+    close(im->fd);
+    im->map = 0;
+    im->fd = -1;
+    im->sectors = 0;
+    im->stat = STA_NOINIT | STA_NODISK;
+}
+
+const DISK_POSIX_STATS* disk_posix_stats(uint8_t drv)
+{
+    IMAGE* im = image_get(drv);
+    return im ? &im->st : 0;
+}
+
+void disk_posix_reset_stats(uint8_t drv)
+{
+    IMAGE* im = image_get(drv);
+    if (im) memset(&im->st, 0, sizeof(im->st));
+}
+
+// ----------------------- diskio.h interface -----------------------
+DSTATUS disk_initialize(BYTE drv)
+{
+    IMAGE* im = image_get(drv);
+
+    if (!im) return STA_NOINIT;
+    if (im->fd >= 0) im->stat &= ~STA_NOINIT;
+    return im->stat;
+}
+
+DSTATUS disk_status(BYTE drv)
+{
+    IMAGE* im = image_get(drv);
+    return im ? im->stat : STA_NOINIT;
+}
+
+DRESULT disk_read(BYTE drv, BYTE* buff, DWORD sector, BYTE count)
+{
+    return image_read(drv, buff, sector, count, false);
+}
+
+DRESULT disk_write(BYTE drv, const BYTE* buff, DWORD sector, BYTE count)
+{
+    return image_write(drv, buff, sector, count, false);
+}
+
+DRESULT disk_read_meta(BYTE drv, BYTE* buff, DWORD sector, BYTE count)
+{
+    return image_read(drv, buff, sector, count, true);
+}
+
+DRESULT disk_write_meta(BYTE drv, const BYTE* buff, DWORD sector, BYTE count)
+{
+    return image_write(drv, buff, sector, count, true);
+}
+
+DRESULT disk_read_async(BYTE drv, BYTE* buff, DWORD sector, BYTE count,
+                        DISK_CALLBACK cb, void* arg)
+{
+    DRESULT res = image_read(drv, buff, sector, count, false);
+    if (res == RES_OK && cb) cb(res, arg);
+    return res;
+}
+
+DRESULT disk_write_async(BYTE drv, const BYTE* buff, DWORD sector, BYTE count,
+                         DISK_CALLBACK cb, void* arg)
+{
+    DRESULT res = image_write(drv, buff, sector, count, false);
+    if (res == RES_OK && cb) cb(res, arg);
+    return res;
+}
+
+DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void* buff)
+{
+    IMAGE* im = image_get(drv);
+    DWORD* dp;
+
+    if (!im) return RES_PARERR;
+    if (im->stat & STA_NOINIT) return RES_NOTRDY;
+    im->st.ioctls++;
+
+    switch (ctrl) {
+    case CTRL_SYNC:
+        im->st.syncs++;
+        if (im->flags & DISK_POSIX_FSYNC) {
+            if (im->map && msync(im->map, im->map_len, MS_SYNC)) return RES_ERROR;
+            if (fsync(im->fd)) return RES_ERROR;
+        }
+        return RES_OK;
+
+    case GET_SECTOR_COUNT:
+        *(DWORD*)buff = (DWORD)im->sectors;
+        return RES_OK;
+
+    case GET_SECTOR_SIZE:
+        *(WORD*)buff = SECTOR_SIZE;
+        return RES_OK;
+
+    case GET_BLOCK_SIZE:
+        *(DWORD*)buff = 1;              // Unknown
+        return RES_OK;
+
+    case CTRL_ERASE_SECTOR:
+        // Erase is a hint to the medium; the data is left as it is
+        dp = buff;
+        if (dp[1] < dp[0] || dp[1] >= im->sectors) return RES_PARERR;
+        im->st.erases++;
+        im->st.sectors_erased += dp[1] - dp[0] + 1;
+        return RES_OK;
+    }
+    return RES_PARERR;
+}
+
+void disk_timerproc(void)
+{
+}
+
+// ----------------------- RTC -----------------------
+DWORD get_fattime(void)
+{
+    time_t now = time(0);
+    struct tm tm;
+
+    localtime_r(&now, &tm);
+    return ((DWORD)(tm.tm_year - 80) << 25) | ((DWORD)(tm.tm_mon + 1) << 21) |
+           ((DWORD)tm.tm_mday << 16) | ((DWORD)tm.tm_hour << 11) |
+           ((DWORD)tm.tm_min << 5) | ((DWORD)tm.tm_sec >> 1);
+}
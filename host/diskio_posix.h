@@ -0,0 +1,67 @@
+//*****************************************************************************
+//
+// diskio_posix.h - FatFs disk I/O layer over image files on a POSIX host.
+//
+// diskio_posix.c implements the diskio.h interface against one image file
+// per physical drive, accessed through pread()/pwrite() or a shared mmap(),
+// so ff.c can be built and exercised as a host library. Every call is
+// counted per drive.
+//
+//*****************************************************************************
+
+#ifndef __DISKIO_POSIX_H__
+#define __DISKIO_POSIX_H__
+
+#include <stdint.h>
+#include "diskio.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+//*****************************************************************************
+//
+// Flags for disk_posix_attach().
+//
+//*****************************************************************************
+#define DISK_POSIX_MMAP         0x01    // Map the image instead of pread/pwrite
+#define DISK_POSIX_RDONLY       0x02    // Open read-only (STA_PROTECT)
+#define DISK_POSIX_FSYNC        0x04    // CTRL_SYNC flushes to the host disk
+
+//*****************************************************************************
+//
+// Per-drive counters.
+//
+//*****************************************************************************
+typedef struct
+{
+    uint64_t    reads;                  // disk_read/disk_read_meta calls
+    uint64_t    writes;                 // disk_write/disk_write_meta calls
+    uint64_t    meta_reads;             // ... of which through the _meta calls
+    uint64_t    meta_writes;
+    uint64_t    sectors_read;
+    uint64_t    sectors_written;
+    uint64_t    syncs;                  // CTRL_SYNC
+    uint64_t    erases;                 // CTRL_ERASE_SECTOR
+    uint64_t    sectors_erased;
+    uint64_t    ioctls;                 // All disk_ioctl calls
+}
+DISK_POSIX_STATS;
+
+//*****************************************************************************
+//
+// Prototypes.
+//
+//*****************************************************************************
+extern int disk_posix_attach(uint8_t ui8Drive, const char *pcImage,
+                             uint32_t ui32Flags);
+extern void disk_posix_detach(uint8_t ui8Drive);
+extern const DISK_POSIX_STATS *disk_posix_stats(uint8_t ui8Drive);
+extern void disk_posix_reset_stats(uint8_t ui8Drive);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __DISKIO_POSIX_H__
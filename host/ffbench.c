@@ -0,0 +1,495 @@
+//*****************************************************************************
+//
+// ffbench.c - FatFs workload benchmark for host builds.
+//
+// Runs the FatFs API through the workload shapes of the application and
+// prints one CSV line per operation: wall time plus the disk I/O and FatFs
+// window/FAT counters it caused. Comparing two runs shows regressions in
+// ff.c or diskio.c as numbers.
+//
+// Workloads, in order, on a freshly formatted image:
+//   mkfs        f_mkfs of the whole image
+//   seqwrite    16 MB written with f_write chunks of 512 B, 4 KB, 32 KB and 128 KB
+//   seqread     ... read back with the same chunk size
+//   expand      f_expand of a 16 MB file
+//   expwrite    ... written in 128 KB chunks through the same file object
+//   expread     ... and read back through it
+//   append      main.c's f_open/f_lseek(f_size)/f_write/f_close loop
+//   appendbig   ... on the 16 MB 128 KB-chunk file
+//   appendopen  ... on the 16 MB 32 KB-chunk file, opened with FA_OPEN_APPEND
+//   mkfiles     small files created in one directory
+//   openfiles   ... opened and read back in creation order
+//   seek        random f_lseek/f_read of 512 B in the 32 KB-chunk file
+//   fill        the volume filled with files grown by f_lseek, the free
+//               space split over 16 of them or more (at most 1 GB each)
+//   mount       remount of the full volume (includes the _FS_FREEMAP scan)
+//   getfree     f_getfree, with the FSInfo count discarded unless the free
+//               map already has an exact count; bytes is the FAT scanned
+//   fragwrite   8 MB written into a hole freed in the middle of the full
+//               volume, after a remount
+//   unlink      the fill files deleted
+//
+// The default backend is host/diskio_posix.c over an image file, built with
+//   gcc -O2 -I. -DENABLE_MKFS -DENABLE_STATS -o ffbench
+//       host/ffbench.c ff.c host/diskio_posix.c
+// Times are wall clock; reads/writes count disk_read/disk_write calls.
+// The FatFs caches are measured at larger sizes than the ffconf.h defaults,
+// so add these flags to either build command:
+//   -D_FS_WINCACHE=4 -D_FS_EXTCACHE=8 -D_FS_TAILCACHE=2
+// fat_scan counts the FAT sectors searched or counted a sector at a time
+// (FAT16/32), so us / fat_scan is the cost of one sector on getfree.
+//
+// Defining FFBENCH_SDEMU builds against the real driver and the SD card
+// emulator instead:
+//   gcc -O2 -I. -DPART_TM4C123GH6PM -DENABLE_MKFS -DENABLE_STATS
+//       -DFFBENCH_SDEMU -o ffbench host/ffbench.c ff.c diskio.c host/sdemu.c
+// Times are then the emulator's virtual time. reads/writes count the read
+// and write commands the card received (CMD17/18, CMD24/25). A small image
+// (-s) keeps the run short.
+//
+// Usage: ffbench [-m] [-s size_mb] image
+//   -m          map the image instead of pread/pwrite (POSIX backend)
+//   -s size_mb  image size, default 32768 (created sparse)
+//   image       file to create or overwrite, e.g. /tmp/ffbench.img
+//
+//*****************************************************************************
+
+#define _FILE_OFFSET_BITS 64
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ff.h"
+#include "diskio.h"
+
+#ifdef FFBENCH_SDEMU
+#include "inc/hw_memmap.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/gpio.h"
+#include "driverlib/systick.h"
+#include "host/sdemu.h"
+#else
+#include "host/diskio_posix.h"
+#endif
+
+#if !_USE_MKFS || !_FS_STATS
+#error ffbench needs ENABLE_MKFS and ENABLE_STATS
+#endif
+
+#define SEQ_BYTES       (16UL << 20)
+#define APPEND_LOOPS    1000
+#define SMALL_FILES     256
+#define SMALL_BYTES     100
+#define SEEK_READS      2000
+#define FILL_FILES      16              // Fill files at least, space allowing
+#define FILL_MAX        0x40000000UL    // Largest fill file
+#define FRAG_BYTES      0x800000        // Written by frag_write
+
+// ----------------------- I/O counters -----------------------
+typedef struct
+{
+    uint64_t    ns;
+    uint64_t    reads, writes;
+    uint64_t    sectors_read, sectors_written;
+}
+IOCOUNT;
+
+static FATFS Fs;
+static uint8_t Buf[131072];
+
+#ifdef FFBENCH_SDEMU
+static void systick_isr(void)
+{
+    disk_timerproc();
+}
+
+DWORD get_fattime(void)
+{
+    return ((DWORD)(2025 - 1980) << 25) | ((DWORD)1 << 21) | ((DWORD)1 << 16);
+}
+
+static int backend_attach(const char* path, bool map)
+{
+    (void)map;
+    if (sdemu_attach(SSI0_BASE, GPIO_PORTA_BASE, GPIO_PIN_3, path, 0)) return -1;
+    SysTickPeriodSet(SysCtlClockGet() / 1000);
+    SysTickIntRegister(systick_isr);
+    SysTickEnable();
+    return 0;
+}
+
+static void backend_count(IOCOUNT* c)
+{
+    const SDEMU_STATS* st = sdemu_stats(SSI0_BASE);
+
+    c->ns = sdemu_time_ns();
+    c->reads = st->cmds[17] + st->cmds[18];
+    c->writes = st->cmds[24] + st->cmds[25];
+    c->sectors_read = st->sectors_read;
+    c->sectors_written = st->sectors_written;
+}
+#else
+static int backend_attach(const char* path, bool map)
+{
+    return disk_posix_attach(0, path, map ? DISK_POSIX_MMAP : 0);
+}
+
+static void backend_count(IOCOUNT* c)
+{
+    const DISK_POSIX_STATS* st = disk_posix_stats(0);
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    c->ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    c->reads = st->reads;
+    c->writes = st->writes;
+    c->sectors_read = st->sectors_read;
+    c->sectors_written = st->sectors_written;
+}
+#endif
+
+// ----------------------- Reporting -----------------------
+static IOCOUNT Start;
+
+static void op_begin(void)
+{
+    memset(&Fs.stats, 0, sizeof(Fs.stats));
+    backend_count(&Start);
+}
+
+static void op_end(const char* op, uint32_t param, uint64_t bytes)
+{
+    IOCOUNT e;
+
+    backend_count(&e);
+    printf("%s,%u,%llu,%llu,%llu,%llu,%llu,%llu,%u,%u,%u,%u,%u,%u,%u\n",
+           op, (unsigned)param, (unsigned long long)bytes,
+           (unsigned long long)((e.ns - Start.ns) / 1000),
+           (unsigned long long)(e.reads - Start.reads),
+           (unsigned long long)(e.writes - Start.writes),
+           (unsigned long long)(e.sectors_read - Start.sectors_read),
+           (unsigned long long)(e.sectors_written - Start.sectors_written),
+           (unsigned)Fs.stats.win_hit, (unsigned)Fs.stats.win_miss,
+           (unsigned)Fs.stats.win_cached, (unsigned)Fs.stats.win_flush, (unsigned)Fs.stats.fat_get,
+           (unsigned)Fs.stats.fat_put, (unsigned)Fs.stats.fat_scan);
+    fflush(stdout);
+}
+
+static void check(FRESULT res, const char* what)
+{
+    if (res != FR_OK) {
+        fprintf(stderr, "ffbench: %s failed (%d)\n", what, (int)res);
+        exit(1);
+    }
+}
+
+// ----------------------- Workloads -----------------------
+static void seq_write(const char* path, UINT chunk)
+{
+    FIL f;
+    UINT bw;
+    DWORD n;
+
+    op_begin();
+    check(f_open(&f, path, FA_WRITE | FA_CREATE_ALWAYS), "seqwrite open");
+    for (n = 0; n < SEQ_BYTES; n += chunk) {
+        memset(Buf, (int)(n / chunk), chunk);
+        check(f_write(&f, Buf, chunk, &bw), "seqwrite");
+        if (bw != chunk) check(FR_DENIED, "seqwrite (disk full)");
+    }
+    check(f_close(&f), "seqwrite close");
+    op_end("seqwrite", chunk, SEQ_BYTES);
+}
+
+static void seq_read(const char* path, UINT chunk)
+{
+    FIL f;
+    UINT br;
+    DWORD n;
+
+    op_begin();
+    check(f_open(&f, path, FA_READ), "seqread open");
+    for (n = 0; n < SEQ_BYTES; n += chunk) {
+        check(f_read(&f, Buf, chunk, &br), "seqread");
+        if (br != chunk || Buf[0] != (uint8_t)(n / chunk) ||
+            Buf[chunk - 1] != (uint8_t)(n / chunk))
+            check(FR_INT_ERR, "seqread (data mismatch)");
+    }
+    check(f_close(&f), "seqread close");
+    op_end("seqread", chunk, SEQ_BYTES);
+}
+
+// A capture file: f_expand the whole size up front, then write and read it
+// back through the same file object, which knows the chain is contiguous
+static void expand_write(const char* path, UINT chunk)
+{
+    FIL f;
+    UINT bw;
+    DWORD n;
+
+    check(f_open(&f, path, FA_READ | FA_WRITE | FA_CREATE_ALWAYS), "expand open");
+    op_begin();
+    check(f_expand(&f, SEQ_BYTES, 1), "expand");
+    op_end("expand", 1, SEQ_BYTES);
+
+    op_begin();
+    for (n = 0; n < SEQ_BYTES; n += chunk) {
+        memset(Buf, (int)(n / chunk), chunk);
+        check(f_write(&f, Buf, chunk, &bw), "expwrite");
+    }
+    check(f_sync(&f), "expwrite sync");
+    op_end("expwrite", chunk, SEQ_BYTES);
+
+    op_begin();
+    check(f_lseek(&f, 0), "expread lseek");
+    for (n = 0; n < SEQ_BYTES; n += chunk) {
+        check(f_read(&f, Buf, chunk, &bw), "expread");
+        if (bw != chunk || Buf[0] != (uint8_t)(n / chunk) ||
+            Buf[chunk - 1] != (uint8_t)(n / chunk))
+            check(FR_INT_ERR, "expread (data mismatch)");
+    }
+    op_end("expread", chunk, SEQ_BYTES);
+    check(f_close(&f), "expand close");
+}
+
+// The logging pattern of main.c: reopen, seek to the end, add a line, close.
+// With FA_OPEN_APPEND the open itself moves to the end.
+static void append_loop(const char* op, const char* path, BYTE mode)
+{
+    FIL f;
+    UINT bw, len;
+    uint64_t bytes = 0;
+    char line[32];
+    int i;
+
+    op_begin();
+    for (i = 1; i <= APPEND_LOOPS; i++) {
+        check(f_open(&f, path, FA_WRITE | mode), "append open");
+        if (mode != FA_OPEN_APPEND)
+            check(f_lseek(&f, f_size(&f)), "append lseek");
+        len = (UINT)sprintf(line, "%d\n", i);
+        check(f_write(&f, line, len, &bw), "append write");
+        check(f_close(&f), "append close");
+        bytes += len;
+    }
+    op_end(op, APPEND_LOOPS, bytes);
+}
+
+static void small_files(void)
+{
+    FIL f;
+    UINT n;
+    char path[32];
+    int i;
+
+    check(f_mkdir("small"), "mkdir");
+    memset(Buf, 'x', SMALL_BYTES);
+
+    op_begin();
+    for (i = 0; i < SMALL_FILES; i++) {
+        sprintf(path, "small/f%04d.txt", i);
+        check(f_open(&f, path, FA_WRITE | FA_CREATE_NEW), "mkfiles open");
+        check(f_write(&f, Buf, SMALL_BYTES, &n), "mkfiles write");
+        check(f_close(&f), "mkfiles close");
+    }
+    op_end("mkfiles", SMALL_FILES, (uint64_t)SMALL_FILES * SMALL_BYTES);
+
+    op_begin();
+    for (i = 0; i < SMALL_FILES; i++) {
+        sprintf(path, "small/f%04d.txt", i);
+        check(f_open(&f, path, FA_READ), "openfiles open");
+        check(f_read(&f, Buf, SMALL_BYTES, &n), "openfiles read");
+        check(f_close(&f), "openfiles close");
+    }
+    op_end("openfiles", SMALL_FILES, (uint64_t)SMALL_FILES * SMALL_BYTES);
+}
+
+static void random_seek(const char* path)
+{
+    FIL f;
+    UINT br;
+    uint32_t lcg = 12345;
+    DWORD ofs;
+    int i;
+
+    op_begin();
+    check(f_open(&f, path, FA_READ), "seek open");
+    for (i = 0; i < SEEK_READS; i++) {
+        lcg = lcg * 1103515245u + 12345u;
+        ofs = (lcg >> 8) % (SEQ_BYTES - 512);
+        check(f_lseek(&f, ofs), "seek lseek");
+        check(f_read(&f, Buf, 512, &br), "seek read");
+    }
+    check(f_close(&f), "seek close");
+    op_end("seek", SEEK_READS, (uint64_t)SEEK_READS * 512);
+}
+
+// Fill the volume with files grown by f_lseek, which allocates clusters
+// without writing data. The free space is split over FILL_FILES files or
+// more, each big enough for frag_write's hole. Returns the number of files
+// created.
+static int fill_volume(void)
+{
+    FATFS* fs;
+    FIL f;
+    char path[32];
+    uint64_t bytes = 0, size;
+    DWORD nclst;
+    int n = 0;
+
+    check(f_getfree("", &nclst, &fs), "fill getfree");
+    size = (uint64_t)(nclst / FILL_FILES) * fs->csize * 512;
+    if (size > FILL_MAX) size = FILL_MAX;
+    if (size < FRAG_BYTES) size = FRAG_BYTES;
+
+    op_begin();
+    for (;;) {
+        sprintf(path, "fill%04d.bin", n);
+        check(f_open(&f, path, FA_WRITE | FA_CREATE_ALWAYS), "fill open");
+        n++;
+        check(f_lseek(&f, (DWORD)size), "fill lseek");
+        bytes += f_tell(&f);
+        check(f_close(&f), "fill close");
+        if (f_tell(&f) < size) break;           // Volume full
+    }
+    op_end("fill", n, bytes);
+    return n;
+}
+
+static void get_free(void)
+{
+    FATFS* fs;
+    DIR dir;
+    DWORD nclst;
+
+    check(f_mount(0, 0), "unmount");
+    op_begin();
+    check(f_mount(0, &Fs), "mount");
+    check(f_opendir(&dir, ""), "remount");
+    op_end("mount", 0, 0);
+
+#if !_FS_FREEMAP
+    // Discard the FSInfo free count to force the FAT scan
+    Fs.free_clust = 0xFFFFFFFF;
+#endif
+    op_begin();
+    check(f_getfree("", &nclst, &fs), "getfree");
+    op_end("getfree", nclst, (uint64_t)Fs.stats.fat_scan * 512);
+}
+
+// Free the middle fill file and write into the hole after a remount. The
+// allocation hint is left at the end of the volume, so the first cluster
+// search wraps and walks the used first half of the FAT.
+static void frag_write(int n)
+{
+    FIL f;
+    DIR dir;
+    char path[32];
+    UINT bw;
+    int i;
+
+    sprintf(path, "fill%04d.bin", n / 2);
+    check(f_unlink(path), "frag unlink");
+    check(f_mount(0, 0), "unmount");
+    check(f_mount(0, &Fs), "mount");
+    check(f_opendir(&dir, ""), "remount");
+
+    op_begin();
+    check(f_open(&f, "frag.bin", FA_WRITE | FA_CREATE_ALWAYS), "frag open");
+    for (i = 0; i < FRAG_BYTES / 32768; i++)
+        check(f_write(&f, Buf, 32768, &bw), "frag write");
+    check(f_close(&f), "frag close");
+    op_end("fragwrite", 32768, FRAG_BYTES);
+    check(f_unlink("frag.bin"), "frag unlink");
+}
+
+static void unlink_files(int n)
+{
+    char path[32];
+    FRESULT res;
+    int i;
+
+    op_begin();
+    for (i = 0; i < n; i++) {
+        sprintf(path, "fill%04d.bin", i);
+        res = f_unlink(path);
+        if (res != FR_NO_FILE) check(res, "unlink");    // frag_write's hole
+    }
+    op_end("unlink", n, 0);
+}
+
+// ----------------------- Main -----------------------
+static int usage(const char* prog)
+{
+    fprintf(stderr, "usage: %s [-m] [-s size_mb] image\n", prog);
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    const char* path;
+    unsigned long size_mb = 32768;
+    bool map = false;
+    int opt, fd, n;
+
+    while ((opt = getopt(argc, argv, "ms:")) != -1) {
+        switch (opt) {
+        case 'm': map = true; break;
+        case 's': size_mb = strtoul(optarg, 0, 0); break;
+        default: return usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1) return usage(argv[0]);
+    path = argv[optind];
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)size_mb << 20)) {
+        perror(path);
+        return 1;
+    }
+    close(fd);
+    if (backend_attach(path, map)) {
+        perror(path);
+        return 1;
+    }
+    if (disk_initialize(0) & STA_NOINIT) {
+        fprintf(stderr, "ffbench: disk_initialize failed\n");
+        return 1;
+    }
+
+    printf("op,param,bytes,us,reads,writes,sectors_read,sectors_written,"
+           "win_hit,win_miss,win_cached,win_flush,fat_get,fat_put,fat_scan\n");
+
+    check(f_mount(0, &Fs), "mount");
+    op_begin();
+    check(f_mkfs(0, 0, 0), "mkfs");
+    op_end("mkfs", (uint32_t)size_mb, (uint64_t)size_mb << 20);
+
+    seq_write("seq512.bin", 512);
+    seq_read("seq512.bin", 512);
+    seq_write("seq4k.bin", 4096);
+    seq_read("seq4k.bin", 4096);
+    seq_write("seq32k.bin", 32768);
+    seq_read("seq32k.bin", 32768);
+    seq_write("seq128k.bin", 131072);
+    seq_read("seq128k.bin", 131072);
+    expand_write("expand.bin", 131072);
+    append_loop("append", "append.txt", FA_OPEN_ALWAYS);
+    append_loop("appendbig", "seq128k.bin", FA_OPEN_ALWAYS);
+    append_loop("appendopen", "seq32k.bin", FA_OPEN_APPEND);
+    small_files();
+    random_seek("seq32k.bin");
+    n = fill_volume();
+    get_free();
+    frag_write(n);
+    unlink_files(n);
+
+    check(f_mount(0, 0), "unmount");
+    return 0;
+}
@@ -0,0 +1,1215 @@
+//*****************************************************************************
+//
+// sdemu.c - Host-side SD card (SPI mode) emulator.
+//
+// Replaces the Tiva driver library on Linux: the SSI data path of each
+// attached SSI module is wired to an SD card state machine that implements
+// the SPI-mode protocol (CMD0/1/6/8/9/10/12/13/16/17/18/24/25/32/33/38/
+// 55/58/59, ACMD13/23/41, data tokens and busy signalling) over an image
+// file. See sdemu.h for the timing model.
+//
+// Build (from the repository root):
+//   gcc -O2 -I. -DPART_TM4C123GH6PM -o sdtest app.c diskio.c host/sdemu.c
+//
+// where app.c is the program exercising the driver (disk_initialize() etc.).
+//
+//*****************************************************************************
+
+#define _FILE_OFFSET_BITS 64
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/gpio.h"
+#include "driverlib/ssi.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/cpu.h"
+#include "driverlib/udma.h"
+#include "driverlib/systick.h"
+#include "host/sdemu.h"
+
+#define NUM_SSI     4
+#define RXQ_LEN     64          // Must be a power of 2
+#define OUT_LEN     1024
+
+// ----------------------- Card model -----------------------
+typedef struct
+{
+    bool        used;
+    int         fd;
+    uint64_t    nsect;
+    SDEMU_TIMING t;
+    SDEMU_STATS st;
+    uint32_t    cs_port;
+    uint8_t     cs_pin;
+    bool        selected;
+
+    // Command receiver
+    uint8_t     cmd[6];
+    int         cmd_len;
+    bool        idle;
+    bool        app;
+    bool        crc_on;
+    bool        hs;
+    bool        init_started;
+    uint64_t    ready_at;
+
+    // Output queue (card -> host)
+    uint8_t     out[OUT_LEN];
+    int         out_rd, out_wr;
+    uint64_t    out_at;
+    uint64_t    busy_until;
+    uint64_t    busy_pending;
+
+    // Read data phase
+    bool        rd_active;
+    bool        rd_multi;
+    bool        rd_armed;
+    uint64_t    rd_at;
+    uint32_t    rd_lba;
+
+    // Write data phase
+    int         wr_state;       // 0: none, 1: wait token, 2: data
+    bool        wr_multi;
+    uint32_t    wr_lba;
+    uint32_t    wr_start;
+    uint32_t    wr_blocks;
+    uint32_t    pre_erase;
+    uint8_t     blk[514];
+    int         blk_pos;
+
+    uint32_t    er_start, er_end;
+    uint32_t    lcg;
+    uint32_t    err_count;
+}
+CARD;
+
+// ----------------------- SSI model -----------------------
+typedef struct
+{
+    uint32_t    base;
+    bool        enabled;
+    uint32_t    width;
+    uint32_t    bitrate;
+    uint64_t    frame_ns;
+    uint64_t    wire_free;
+    uint32_t    rxq[RXQ_LEN];
+    uint64_t    rxt[RXQ_LEN];
+    uint32_t    rx_rd, rx_wr;
+    uint32_t    im;
+    uint32_t    ris;
+    uint32_t    dma;
+    bool        int_en;
+    bool        pend;           // Set by IntPendSet
+    void        (*handler)(void);
+    CARD        card;
+}
+SSI;
+
+static SSI g_ssi[NUM_SSI] = {
+    { .base = SSI0_BASE }, { .base = SSI1_BASE },
+    { .base = SSI2_BASE }, { .base = SSI3_BASE }
+};
+
+static uint64_t g_now;              // Virtual time in ns
+static bool     g_master = true;    // Interrupt master enable
+static int      g_in_isr;
+static uint32_t g_sysclk = 80000000;
+static uint32_t g_call_ns = 100;
+
+// ----------------------- uDMA model -----------------------
+typedef struct
+{
+    uint32_t    ctl;
+    uint8_t     *src, *dst;
+    uint32_t    left;
+    bool        en;
+}
+DMACH;
+
+static DMACH    g_dma[32];
+static uint32_t g_dma_map[32];      // Channel map encodings
+static uint32_t g_dma_chis;         // Completed peripheral channels
+static bool     g_dma_on;
+
+// ----------------------- SysTick model -----------------------
+static uint32_t g_st_period = 1;
+static bool     g_st_en, g_st_int;
+static uint64_t g_st_base;          // Time the counter was last reloaded
+static uint64_t g_st_next;          // Next wrap to deliver
+static void     (*g_st_handler)(void);
+
+static void irq_poll(void);
+static void dma_service(void);
+
+// ----------------------- Helpers -----------------------
+static void fatal(const char *msg)
+{
+    fprintf(stderr, "sdemu: %s\n", msg);
+    exit(2);
+}
+
+static SSI *ssi_get(uint32_t base)
+{
+    int i;
+    for (i = 0; i < NUM_SSI; i++)
+        if (g_ssi[i].base == base) return &g_ssi[i];
+    fatal("bad SSI base");
+    return 0;
+}
+
+static void tick(void)
+{
+    g_now += g_call_ns;
+    dma_service();
+    irq_poll();
+}
+
+static uint8_t crc7(const uint8_t *p, int n)
+{
+    uint8_t crc = 0;
+    int i, b;
+    for (i = 0; i < n; i++) {
+        uint8_t d = p[i];
+        for (b = 0; b < 8; b++) {
+            crc <<= 1;
+            if ((d ^ crc) & 0x80) crc ^= 0x09;
+            d <<= 1;
+        }
+    }
+    return (uint8_t)((crc << 1) | 1);
+}
+
+static uint16_t crc16(const uint8_t *p, int n)
+{
+    uint16_t crc = 0;
+    int i, b;
+    for (i = 0; i < n; i++) {
+        crc ^= (uint16_t)p[i] << 8;
+        for (b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+static void out_push(CARD *c, uint8_t b)
+{
+    if (c->out_wr - c->out_rd >= OUT_LEN) fatal("card output overflow");
+    c->out[c->out_wr++ % OUT_LEN] = b;
+}
+
+static bool out_empty(CARD *c)
+{
+    return c->out_rd == c->out_wr;
+}
+
+static void out_clear(CARD *c)
+{
+    c->out_rd = c->out_wr = 0;
+}
+
+static uint32_t clk_limit(const CARD *c)
+{
+    return c->hs ? c->t.hs_max_clk_hz : c->t.max_clk_hz;
+}
+
+// Flip bits in a data payload when the bus runs faster than the card allows
+static void corrupt(CARD *c, SSI *s, uint8_t *p, int n)
+{
+    int i;
+    if (s->bitrate <= clk_limit(c) || !c->t.err_interval) return;
+    for (i = 0; i < n; i++) {
+        if (++c->err_count >= c->t.err_interval) {
+            c->lcg = c->lcg * 1103515245u + 12345u;
+            p[i] ^= (uint8_t)(1u << ((c->lcg >> 16) & 7));
+            c->err_count = (c->lcg >> 20) % (c->t.err_interval / 2 + 1);
+            c->st.bit_errors++;
+        }
+    }
+}
+
+static int img_io(CARD *c, uint32_t lba, uint8_t *buf, bool wr)
+{
+    off_t off = (off_t)lba * 512;
+    ssize_t r;
+    if (lba >= c->nsect) return -1;
+    r = wr ? pwrite(c->fd, buf, 512, off) : pread(c->fd, buf, 512, off);
+    if (!wr && r >= 0 && r < 512) memset(buf + r, 0, 512 - r);
+    return (r < 0) ? -1 : 0;
+}
+
+// ----------------------- Card registers -----------------------
+static void make_csd(CARD *c, uint8_t *csd)
+{
+    memset(csd, 0, 16);
+    if (c->t.sdhc) {
+        uint32_t csize = (uint32_t)(c->nsect / 1024) - 1;
+        csd[0] = 0x40;                  // CSD v2
+        csd[1] = 0x0E;                  // TAAC
+        csd[2] = 0x00;
+        csd[3] = c->hs ? 0x5A : 0x32;   // TRAN_SPEED 50/25 MHz
+        csd[4] = 0x5B; csd[5] = 0x59;   // CCC, READ_BL_LEN = 9
+        csd[7] = (csize >> 16) & 0x3F;
+        csd[8] = csize >> 8;
+        csd[9] = csize;
+        csd[10] = 0x7F; csd[11] = 0x80; // ERASE_BLK_EN, SECTOR_SIZE = 127
+        csd[12] = 0x0A; csd[13] = 0x40; // R2W_FACTOR, WRITE_BL_LEN = 9
+    } else {
+        // CSD v1: capacity = (C_SIZE+1) * 2^(C_SIZE_MULT+2) * 2^READ_BL_LEN
+        uint32_t mult = 7, csize;
+        csize = (uint32_t)(c->nsect >> (mult + 2)) - 1;
+        csd[0] = 0x00;
+        csd[1] = 0x26; csd[2] = 0x00;
+        csd[3] = c->hs ? 0x5A : 0x32;
+        csd[4] = 0x5F; csd[5] = 0x59;   // READ_BL_LEN = 9
+        csd[6] = 0x80 | ((csize >> 10) & 3);
+        csd[7] = csize >> 2;
+        csd[8] = (uint8_t)((csize & 3) << 6) | 0x2D;
+        csd[9] = 0xB4 | ((mult >> 1) & 3);
+        csd[10] = (uint8_t)(((mult & 1) << 7) | 0x7F);
+        csd[11] = 0x80;
+        csd[12] = 0x0A; csd[13] = 0x40;
+    }
+    csd[15] = crc7(csd, 15);
+}
+
+static void make_cid(uint8_t *cid)
+{
+    static const uint8_t k[15] = {
+        0x03, 'S', 'D', 'E', 'M', 'U', 'L', '8',
+        0x10, 0x12, 0x34, 0x56, 0x78, 0x01, 0x8A
+    };
+    memcpy(cid, k, 15);
+    cid[15] = crc7(cid, 15);
+}
+
+static void make_sdstat(CARD *c, uint8_t *st)
+{
+    static const uint16_t au_size[16] = {   // AU_SIZE codes, in 16 KB units
+        0, 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 768, 1024, 1536, 2048, 4096
+    };
+    uint32_t au = 1;
+    memset(st, 0, 64);
+    while (au < 15 && au_size[au + 1] * 32u <= c->t.au_sectors) au++;
+    st[8] = 0x04;                       // SPEED_CLASS: class 10
+    st[9] = 0x0A;                       // PERFORMANCE_MOVE
+    st[10] = (uint8_t)(au << 4);        // AU_SIZE: largest not above au_sectors
+    st[11] = 0x00; st[12] = 0x01;       // ERASE_SIZE: 1 AU
+    st[13] = (0x02 << 2) | 0x01;        // ERASE_TIMEOUT, ERASE_OFFSET
+}
+
+static void make_switch(CARD *c, uint32_t arg, uint8_t *st)
+{
+    uint32_t fn = arg & 0x0F;
+    memset(st, 0, 64);
+    st[0] = 0x00; st[1] = 0x64;         // Max current 100 mA
+    st[12] = 0x80;
+    st[13] = c->t.hs_capable ? 0x03 : 0x01;
+    if (fn == 0x0F) fn = c->hs ? 1 : 0;
+    else if (fn == 1 && !c->t.hs_capable) fn = 0x0F;
+    else if (fn > 1) fn = 0x0F;
+    st[16] = (uint8_t)fn;
+    st[17] = 0x00;                      // Data structure version 0
+    if ((arg & 0x80000000) && fn == 1) c->hs = true;
+}
+
+static void queue_block(CARD *c, SSI *s, uint8_t tok, const uint8_t *d, int n)
+{
+    uint16_t crc = crc16(d, n);
+    uint8_t b;
+    int i;
+    out_push(c, tok);
+    for (i = 0; i < n; i++) { b = d[i]; corrupt(c, s, &b, 1); out_push(c, b); }
+    out_push(c, crc >> 8);
+    out_push(c, crc);
+}
+
+static bool addr_to_lba(CARD *c, uint32_t arg, uint32_t *lba)
+{
+    if (c->t.sdhc) { *lba = arg; return true; }
+    if (arg & 511) return false;
+    *lba = arg >> 9;
+    return true;
+}
+
+// ----------------------- Card command decoder -----------------------
+static void card_command(CARD *c, SSI *s, uint64_t t)
+{
+    uint8_t idx = c->cmd[0] & 0x3F;
+    uint32_t arg = ((uint32_t)c->cmd[1] << 24) | ((uint32_t)c->cmd[2] << 16) |
+                   ((uint32_t)c->cmd[3] << 8) | c->cmd[4];
+    bool app = c->app;
+    uint8_t r1, buf[64];
+    uint32_t lba;
+
+    c->app = false;
+    if (app) c->st.acmds[idx]++; else c->st.cmds[idx]++;
+
+    out_clear(c);
+    c->out_at = t + s->frame_ns + (c->t.cmd_ns > s->frame_ns ? c->t.cmd_ns : s->frame_ns);
+
+    // CMD0 and CMD8 are always CRC-checked; others only after CMD59
+    if ((idx == 0 || idx == 8 || c->crc_on) && crc7(c->cmd, 5) != c->cmd[5]) {
+        c->st.crc_errors++;
+        out_push(c, 0x08 | (c->idle ? 1 : 0));
+        return;
+    }
+
+    // STOP_TRANSMISSION: stuff byte, then R1, then a short busy
+    if (idx == 12) {
+        c->rd_active = false;
+        c->out_at = t + s->frame_ns;
+        out_push(c, 0x1F);
+        out_push(c, 0xFF);
+        out_push(c, 0x00);
+        c->busy_pending = 2000;
+        return;
+    }
+
+    r1 = c->idle ? 0x01 : 0x00;
+
+    if (app) {
+        switch (idx) {
+        case 41:
+            if (!c->init_started) {
+                c->init_started = true;
+                c->ready_at = t + (uint64_t)c->t.init_ms * 1000000;
+            }
+            if (t >= c->ready_at && (!c->t.sdhc || (arg & (1UL << 30))))
+                c->idle = false;
+            out_push(c, c->idle ? 0x01 : 0x00);
+            return;
+        case 13:
+            out_push(c, r1); out_push(c, 0x00);
+            out_push(c, 0xFF);
+            make_sdstat(c, buf);
+            queue_block(c, s, 0xFE, buf, 64);
+            return;
+        case 23:
+            c->pre_erase = arg & 0x7FFFFF;
+            out_push(c, r1);
+            return;
+        case 22: case 51:
+        default:
+            break;      // Treat as a regular command below
+        }
+    }
+
+    switch (idx) {
+    case 0:
+        c->idle = true;
+        c->crc_on = false;
+        c->hs = false;
+        c->init_started = false;
+        c->rd_active = false;
+        c->wr_state = 0;
+        out_push(c, 0x01);
+        return;
+    case 1:
+        if (!c->init_started) {
+            c->init_started = true;
+            c->ready_at = t + (uint64_t)c->t.init_ms * 1000000;
+        }
+        if (t >= c->ready_at) c->idle = false;
+        out_push(c, c->idle ? 0x01 : 0x00);
+        return;
+    case 8:
+        out_push(c, r1);
+        out_push(c, 0x00); out_push(c, 0x00);
+        out_push(c, (arg >> 8) & 0x0F);
+        out_push(c, arg & 0xFF);
+        return;
+    case 55:
+        c->app = true;
+        out_push(c, r1);
+        return;
+    case 58: {
+        uint32_t ocr = 0x00FF8000;
+        if (!c->idle) ocr |= 0x80000000 | (c->t.sdhc ? 0x40000000 : 0);
+        out_push(c, r1);
+        out_push(c, ocr >> 24); out_push(c, ocr >> 16);
+        out_push(c, ocr >> 8); out_push(c, ocr);
+        return;
+    }
+    case 59:
+        c->crc_on = arg & 1;
+        out_push(c, r1);
+        return;
+    }
+
+    if (c->idle) {                  // Only the above are legal in idle state
+        out_push(c, 0x05);
+        return;
+    }
+
+    switch (idx) {
+    case 6:
+        out_push(c, r1);
+        out_push(c, 0xFF);
+        make_switch(c, arg, buf);
+        queue_block(c, s, 0xFE, buf, 64);
+        return;
+    case 9:
+        out_push(c, r1);
+        out_push(c, 0xFF);
+        make_csd(c, buf);
+        queue_block(c, s, 0xFE, buf, 16);
+        return;
+    case 10:
+        out_push(c, r1);
+        out_push(c, 0xFF);
+        make_cid(buf);
+        queue_block(c, s, 0xFE, buf, 16);
+        return;
+    case 13:
+        out_push(c, r1);
+        out_push(c, 0x00);
+        return;
+    case 16:
+        out_push(c, arg == 512 ? r1 : (r1 | 0x40));
+        return;
+    case 17:
+    case 18:
+        if (!addr_to_lba(c, arg, &lba)) { out_push(c, r1 | 0x20); return; }
+        out_push(c, r1);
+        c->rd_active = true;
+        c->rd_multi = (idx == 18);
+        c->rd_lba = lba;
+        c->rd_armed = true;
+        c->rd_at = c->out_at + (uint64_t)c->t.read_access_us * 1000;
+        return;
+    case 24:
+    case 25:
+        if (!addr_to_lba(c, arg, &lba)) { out_push(c, r1 | 0x20); return; }
+        out_push(c, r1);
+        c->wr_state = 1;
+        c->wr_multi = (idx == 25);
+        c->wr_lba = c->wr_start = lba;
+        c->wr_blocks = 0;
+        if (idx == 24) c->pre_erase = 0;
+        return;
+    case 32:
+        if (!addr_to_lba(c, arg, &c->er_start)) { out_push(c, r1 | 0x20); return; }
+        out_push(c, r1);
+        return;
+    case 33:
+        if (!addr_to_lba(c, arg, &c->er_end)) { out_push(c, r1 | 0x20); return; }
+        out_push(c, r1);
+        return;
+    case 38: {
+        uint32_t n, aus;
+        static const uint8_t zero[512];
+        if (c->er_end < c->er_start || c->er_end >= c->nsect) {
+            out_push(c, r1 | 0x10);     // Erase sequence error
+            return;
+        }
+        for (lba = c->er_start; lba <= c->er_end; lba++)
+            img_io(c, lba, (uint8_t*)zero, true);
+        n = c->er_end - c->er_start + 1;
+        aus = (n + c->t.au_sectors - 1) / c->t.au_sectors;
+        out_push(c, r1);
+        c->busy_pending = (uint64_t)aus * c->t.erase_au_us * 1000;
+        c->st.busy_ns += c->busy_pending;
+        return;
+    }
+    }
+
+    out_push(c, r1 | 0x04);             // Illegal command
+}
+
+// A data block from the host has been received completely
+static void card_write_block(CARD *c, SSI *s, uint64_t t)
+{
+    uint16_t crc = (uint16_t)((c->blk[512] << 8) | c->blk[513]);
+    uint64_t busy;
+
+    c->out_at = t;
+    corrupt(c, s, c->blk, 512);
+    if (c->crc_on && crc != crc16(c->blk, 512)) {
+        c->st.crc_errors++;
+        out_push(c, 0xEB);              // Data rejected, CRC error
+        c->wr_state = c->wr_multi ? 1 : 0;
+        return;
+    }
+    if (img_io(c, c->wr_lba, c->blk, true)) {
+        out_push(c, 0xED);              // Data rejected, write error
+        c->wr_state = c->wr_multi ? 1 : 0;
+        return;
+    }
+    c->st.sectors_written++;
+    c->wr_lba++;
+    c->wr_blocks++;
+    out_push(c, 0xE5);                  // Data accepted
+    if (c->wr_multi) {
+        busy = (uint64_t)c->t.prog_multi_us * 1000;
+        c->wr_state = 1;
+    } else {
+        busy = (uint64_t)c->t.prog_single_us * 1000;
+        if (c->t.au_sectors > 1) busy += (uint64_t)c->t.misalign_us * 1000;
+        c->wr_state = 0;
+    }
+    c->busy_pending = busy;
+    c->st.busy_ns += busy;
+    (void)s;
+}
+
+// Multi-block write stop token
+static void card_write_stop(CARD *c)
+{
+    uint64_t busy = (uint64_t)c->t.prog_stop_us * 1000;
+    uint32_t au = c->t.au_sectors;
+
+    if (au > 1 && ((c->wr_start % au) || (c->wr_lba % au)) &&
+        c->pre_erase < c->wr_blocks)
+        busy += (uint64_t)c->t.misalign_us * 1000;
+    c->pre_erase = 0;
+    c->wr_state = 0;
+    c->busy_pending = busy;
+    c->st.busy_ns += busy;
+}
+
+// Exchange one byte with the card. t is the time the frame starts.
+static uint8_t card_xfer(CARD *c, SSI *s, uint8_t mosi, uint64_t t)
+{
+    uint8_t miso;
+
+    if (!c->used || !c->selected) return 0xFF;
+    c->st.bytes++;
+
+    // Host to card direction is sampled first: a data block being written
+    if (c->wr_state == 2) {
+        uint8_t b = mosi;
+        if (c->blk_pos < 512) corrupt(c, s, &b, 1);
+        c->blk[c->blk_pos++] = b;
+        if (c->blk_pos == 514) card_write_block(c, s, t);
+        return 0xFF;
+    }
+
+    // Card to host direction
+    if (c->busy_pending && out_empty(c)) {
+        c->busy_until = t + c->busy_pending;
+        c->busy_pending = 0;
+    }
+    if (t < c->busy_until) {
+        miso = 0x00;
+    } else {
+        if (out_empty(c) && c->rd_active) {
+            if (!c->rd_armed) {
+                c->rd_armed = true;
+                c->rd_at = t + (uint64_t)c->t.read_next_us * 1000;
+            }
+            if (t >= c->rd_at) {
+                uint8_t d[512];
+                c->out_rd = c->out_wr = 0;
+                c->out_at = t;
+                if (img_io(c, c->rd_lba, d, false)) {
+                    out_push(c, 0x08);  // Data error token: out of range
+                    c->rd_active = false;
+                } else {
+                    uint16_t crc = crc16(d, 512);
+                    int i;
+                    c->st.sectors_read++;
+                    corrupt(c, s, d, 512);
+                    out_push(c, 0xFE);
+                    for (i = 0; i < 512; i++) out_push(c, d[i]);
+                    out_push(c, crc >> 8);
+                    out_push(c, crc);
+                    c->rd_lba++;
+                    if (!c->rd_multi) c->rd_active = false;
+                }
+                c->rd_armed = false;
+            }
+        }
+        if (!out_empty(c) && t >= c->out_at)
+            miso = c->out[c->out_rd++ % OUT_LEN];
+        else
+            miso = 0xFF;
+    }
+
+    // Host to card: tokens of a write transaction
+    if (c->wr_state == 1 && t >= c->busy_until) {
+        if (mosi == (c->wr_multi ? 0xFC : 0xFE)) {
+            c->wr_state = 2;
+            c->blk_pos = 0;
+        } else if (mosi == 0xFD && c->wr_multi) {
+            card_write_stop(c);
+        }
+        return miso;
+    }
+
+    // Host to card: command frames
+    if (c->cmd_len == 0) {
+        if ((mosi & 0xC0) == 0x40) c->cmd[c->cmd_len++] = mosi;
+    } else {
+        c->cmd[c->cmd_len++] = mosi;
+        if (c->cmd_len == 6) {
+            c->cmd_len = 0;
+            card_command(c, s, t);
+        }
+    }
+    return miso;
+}
+
+// ----------------------- SSI frame engine -----------------------
+static uint32_t rx_ready(SSI *s)
+{
+    uint32_t n = 0, i;
+    for (i = s->rx_rd; i != s->rx_wr; i++)
+        if (s->rxt[i % RXQ_LEN] <= g_now) n++;
+    return n;
+}
+
+static uint32_t tx_level(SSI *s)
+{
+    if (s->wire_free <= g_now || !s->frame_ns) return 0;
+    return (uint32_t)((s->wire_free - g_now + s->frame_ns - 1) / s->frame_ns) - 1;
+}
+
+static void check_overrun(SSI *s)
+{
+    while (rx_ready(s) > 8) {       // The ninth frame is lost in hardware
+        s->rx_rd++;
+        s->card.st.overruns++;
+        s->ris |= SSI_RXOR;
+    }
+}
+
+static void frame_push(SSI *s, uint32_t data)
+{
+    uint64_t start;
+    uint32_t r = 0;
+
+    if (!s->enabled) fatal("SSI not enabled");
+    while (tx_level(s) >= 8) g_now = s->wire_free - 8 * s->frame_ns;
+    if (s->rx_wr - s->rx_rd >= RXQ_LEN) fatal("SSI receive queue overflow");
+    start = (s->wire_free > g_now) ? s->wire_free : g_now;
+    if (s->width > 8) {
+        r = (uint32_t)card_xfer(&s->card, s, (uint8_t)(data >> 8), start) << 8;
+        r |= card_xfer(&s->card, s, (uint8_t)data, start + s->frame_ns / 2);
+    } else {
+        r = card_xfer(&s->card, s, (uint8_t)data, start);
+    }
+    s->wire_free = start + s->frame_ns;
+    s->rxq[s->rx_wr % RXQ_LEN] = r;
+    s->rxt[s->rx_wr % RXQ_LEN] = s->wire_free;
+    s->rx_wr++;
+    check_overrun(s);
+}
+
+// ----------------------- uDMA engine -----------------------
+// RX and TX channel numbers serving an SSI under the current channel map
+static int dma_chan(int ssi, bool tx)
+{
+    static const int ch[4][2] = { { 10, 0 }, { 24, 0 }, { 12, 2 }, { 14, 2 } };
+    int c = ch[ssi][0] + (tx ? 1 : 0);
+    uint32_t enc = (ssi == 1 && g_dma_map[10] == 1) ? 1 : (uint32_t)ch[ssi][1];
+
+    if (ssi == 1 && enc == 1) c = 10 + (tx ? 1 : 0);
+    return g_dma_map[c] == enc ? c : -1;
+}
+
+static uint32_t dma_item(const DMACH *d, bool dst)
+{
+    uint32_t inc = dst ? (d->ctl >> 30) & 3 : (d->ctl >> 26) & 3;
+    return inc == 3 ? 0 : 1u << inc;
+}
+
+static void dma_service(void)
+{
+    int i;
+    bool moved;
+
+    if (!g_dma_on) return;
+    for (i = 0; i < NUM_SSI; i++) {
+        SSI *s = &g_ssi[i];
+        int rc = dma_chan(i, false), tc = dma_chan(i, true);
+        DMACH *rx = (rc >= 0 && (s->dma & SSI_DMA_RX)) ? &g_dma[rc] : 0;
+        DMACH *tx = (tc >= 0 && (s->dma & SSI_DMA_TX)) ? &g_dma[tc] : 0;
+
+        if (!s->enabled) continue;
+        do {
+            moved = false;
+            while (rx && rx->en && rx->left && rx_ready(s)) {
+                uint32_t v = s->rxq[s->rx_rd++ % RXQ_LEN];
+                if (((rx->ctl >> 28) & 3) == 1) memcpy(rx->dst, &v, 2);
+                else *rx->dst = (uint8_t)v;
+                rx->dst += dma_item(rx, true);
+                if (!--rx->left) { rx->en = false; g_dma_chis |= 1u << rc; }
+                moved = true;
+            }
+            while (tx && tx->en && tx->left && tx_level(s) < 8) {
+                uint32_t v = 0;
+                if (((tx->ctl >> 24) & 3) == 1) memcpy(&v, tx->src, 2);
+                else v = *tx->src;
+                frame_push(s, v);
+                tx->src += dma_item(tx, false);
+                if (!--tx->left) { tx->en = false; g_dma_chis |= 1u << tc; }
+                moved = true;
+            }
+        } while (moved);
+    }
+}
+
+// True when a completed uDMA channel of this SSI is raising its interrupt
+static bool dma_irq(int ssi)
+{
+    int rc = dma_chan(ssi, false), tc = dma_chan(ssi, true);
+    return (rc >= 0 && (g_dma_chis & (1u << rc))) ||
+           (tc >= 0 && (g_dma_chis & (1u << tc)));
+}
+
+// ----------------------- Interrupt model -----------------------
+static uint32_t ssi_status(SSI *s)
+{
+    uint32_t st = s->ris & (SSI_RXOR | SSI_DMATX | SSI_DMARX);
+    uint32_t rdy = rx_ready(s);
+    if (tx_level(s) <= 4) st |= SSI_TXFF;
+    if (rdy >= 4) st |= SSI_RXFF;
+    if (rdy && g_now >= s->wire_free + 32 * s->frame_ns / (s->width > 8 ? 16 : 8))
+        st |= SSI_RXTO;
+    if (s->wire_free <= g_now) st |= SSI_TXEOT;
+    return st;
+}
+
+static uint64_t st_period_ns(void)
+{
+    return (uint64_t)g_st_period * 1000000000ull / g_sysclk;
+}
+
+static void irq_poll(void)
+{
+    int i, spins;
+
+    if (!g_master || g_in_isr) return;
+    if (g_st_en && g_st_int && g_st_handler) {
+        while (g_st_next <= g_now) {
+            g_st_next += st_period_ns();
+            g_in_isr++;
+            g_st_handler();
+            g_in_isr--;
+        }
+    }
+    for (i = 0; i < NUM_SSI; i++) {
+        SSI *s = &g_ssi[i];
+        if (!s->handler || !s->int_en) continue;
+        for (spins = 0; (ssi_status(s) & s->im) || dma_irq(i) || s->pend; spins++) {
+            if (spins > 100000) fatal("SSI interrupt storm");
+            s->pend = false;
+            g_in_isr++;
+            s->handler();
+            g_in_isr--;
+        }
+    }
+}
+
+// Next time something may happen that an interrupt could depend on
+static uint64_t next_event(void)
+{
+    uint64_t t = UINT64_MAX;
+    int i;
+    if (g_st_en && g_st_int && g_st_handler) t = g_st_next;
+    for (i = 0; i < NUM_SSI; i++) {
+        SSI *s = &g_ssi[i];
+        uint32_t j;
+        if (s->wire_free > g_now && s->wire_free < t) t = s->wire_free;
+        for (j = s->rx_rd; j != s->rx_wr; j++) {
+            uint64_t rt = s->rxt[j % RXQ_LEN];
+            if (rt > g_now && rt < t) t = rt;
+            rt += 32 * s->frame_ns / (s->width > 8 ? 16 : 8);
+            if (rt > g_now && rt < t) t = rt;
+        }
+    }
+    return t;
+}
+
+// ----------------------- Emulator API -----------------------
+void sdemu_defaults(SDEMU_TIMING *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->sdhc = true;
+    p->hs_capable = true;
+    p->au_sectors = 8192;           // 4 MB
+    p->init_ms = 250;
+    p->max_clk_hz = 25000000;
+    p->hs_max_clk_hz = 50000000;
+    p->err_interval = 4096;
+    p->cmd_ns = 2000;
+    p->read_access_us = 400;
+    p->read_next_us = 40;
+    p->prog_single_us = 700;
+    p->prog_multi_us = 60;
+    p->prog_stop_us = 300;
+    p->misalign_us = 2500;
+    p->erase_au_us = 250;
+    p->cpu_hz = 80000000;
+    p->call_ns = 100;
+    p->ssi_max_hz = 25000000;
+}
+
+int sdemu_attach(uint32_t base, uint32_t cs_port, uint8_t cs_pin,
+                 const char *image, const SDEMU_TIMING *t)
+{
+    SSI *s = ssi_get(base);
+    CARD *c = &s->card;
+    struct stat sb;
+
+    memset(c, 0, sizeof(*c));
+    c->fd = open(image, O_RDWR);
+    if (c->fd < 0 || fstat(c->fd, &sb)) return -1;
+    c->nsect = (uint64_t)sb.st_size / 512;
+    if (t) c->t = *t; else sdemu_defaults(&c->t);
+    if (!c->t.sdhc && c->nsect > 4194304) c->nsect = 4194304;
+    c->cs_port = cs_port;
+    c->cs_pin = cs_pin;
+    c->lcg = 0x2545F491;
+    c->idle = true;
+    c->used = true;
+    g_sysclk = c->t.cpu_hz;
+    g_call_ns = c->t.call_ns;
+    return 0;
+}
+
+void sdemu_detach_all(void)
+{
+    int i;
+    for (i = 0; i < NUM_SSI; i++) {
+        if (g_ssi[i].card.used) close(g_ssi[i].card.fd);
+        g_ssi[i].card.used = false;
+    }
+}
+
+uint64_t sdemu_time_ns(void)
+{
+    return g_now;
+}
+
+uint32_t sdemu_clock_hz(uint32_t base)
+{
+    return ssi_get(base)->bitrate;
+}
+
+const SDEMU_STATS *sdemu_stats(uint32_t base)
+{
+    return &ssi_get(base)->card.st;
+}
+
+void sdemu_reset_stats(void)
+{
+    int i;
+    for (i = 0; i < NUM_SSI; i++)
+        memset(&g_ssi[i].card.st, 0, sizeof(SDEMU_STATS));
+}
+
+// ----------------------- driverlib: SysCtl -----------------------
+void SysCtlPeripheralEnable(uint32_t p) { (void)p; tick(); }
+void SysCtlPeripheralDisable(uint32_t p) { (void)p; tick(); }
+void SysCtlPeripheralReset(uint32_t p) { (void)p; tick(); }
+bool SysCtlPeripheralReady(uint32_t p) { (void)p; tick(); return true; }
+uint32_t SysCtlClockGet(void) { tick(); return g_sysclk; }
+void SysCtlClockSet(uint32_t c) { (void)c; tick(); }
+
+void SysCtlDelay(uint32_t n)
+{
+    g_now += (uint64_t)n * 3 * 1000000000ULL / g_sysclk;
+    irq_poll();
+}
+
+// ----------------------- driverlib: GPIO -----------------------
+void GPIOPinConfigure(uint32_t c) { (void)c; tick(); }
+void GPIOPinTypeSSI(uint32_t p, uint8_t m) { (void)p; (void)m; tick(); }
+void GPIOPinTypeGPIOOutput(uint32_t p, uint8_t m) { (void)p; (void)m; tick(); }
+void GPIOPinTypeGPIOInput(uint32_t p, uint8_t m) { (void)p; (void)m; tick(); }
+void GPIOUnlockPin(uint32_t p, uint8_t m) { (void)p; (void)m; tick(); }
+void GPIOPadConfigSet(uint32_t p, uint8_t m, uint32_t s, uint32_t t)
+{
+    (void)p; (void)m; (void)s; (void)t; tick();
+}
+int32_t GPIOPinRead(uint32_t p, uint8_t m) { (void)p; (void)m; tick(); return 0; }
+
+void GPIOPinWrite(uint32_t port, uint8_t pins, uint8_t val)
+{
+    int i;
+    tick();
+    for (i = 0; i < NUM_SSI; i++) {
+        CARD *c = &g_ssi[i].card;
+        if (c->used && c->cs_port == port && (pins & c->cs_pin)) {
+            bool sel = !(val & c->cs_pin);
+            if (sel != c->selected) {
+                // CS only changes after the shifter has drained
+                if (g_ssi[i].wire_free > g_now) g_now = g_ssi[i].wire_free;
+                c->selected = sel;
+                c->cmd_len = 0;
+            }
+        }
+    }
+}
+
+// ----------------------- driverlib: SSI -----------------------
+void SSIConfigSetExpClk(uint32_t base, uint32_t clk, uint32_t proto,
+                        uint32_t mode, uint32_t rate, uint32_t width)
+{
+    SSI *s = ssi_get(base);
+    uint32_t maxbr, prediv = 0, scr;
+
+    (void)mode;
+    tick();
+    if (rate > clk / 2) fatal("SSI bit rate above SysClk/2");
+    maxbr = clk / rate;
+    do {
+        prediv += 2;
+        scr = (maxbr / prediv) - 1;
+    } while (scr > 255);
+    s->bitrate = clk / (prediv * (scr + 1));
+    if (s->card.used && s->bitrate > s->card.t.ssi_max_hz)
+        fatal("SSI bit rate above the part limit");
+    s->width = width;
+    s->enabled = false;             // Writing SSICR1 clears SSE
+    // With SPH=0 the SSI idles one bit time between back-to-back frames to
+    // pulse SSInFss
+    s->frame_ns = (uint64_t)(width + ((proto & 2) ? 0 : 1)) * 1000000000ULL /
+                  s->bitrate;
+}
+
+void SSIEnable(uint32_t base) { tick(); ssi_get(base)->enabled = true; }
+void SSIDisable(uint32_t base) { tick(); ssi_get(base)->enabled = false; }
+
+bool SSIBusy(uint32_t base)
+{
+    SSI *s = ssi_get(base);
+    tick();
+    return s->wire_free > g_now;
+}
+
+void SSIDataPut(uint32_t base, uint32_t data)
+{
+    tick();
+    frame_push(ssi_get(base), data);
+}
+
+int32_t SSIDataPutNonBlocking(uint32_t base, uint32_t data)
+{
+    SSI *s = ssi_get(base);
+    tick();
+    if (tx_level(s) >= 8) return 0;
+    frame_push(s, data);
+    return 1;
+}
+
+void SSIDataGet(uint32_t base, uint32_t *data)
+{
+    SSI *s = ssi_get(base);
+    tick();
+    check_overrun(s);
+    if (s->rx_rd == s->rx_wr) fatal("SSIDataGet with nothing in flight");
+    if (s->rxt[s->rx_rd % RXQ_LEN] > g_now) g_now = s->rxt[s->rx_rd % RXQ_LEN];
+    *data = s->rxq[s->rx_rd++ % RXQ_LEN];
+}
+
+int32_t SSIDataGetNonBlocking(uint32_t base, uint32_t *data)
+{
+    SSI *s = ssi_get(base);
+    tick();
+    check_overrun(s);
+    if (s->rx_rd == s->rx_wr || s->rxt[s->rx_rd % RXQ_LEN] > g_now) return 0;
+    *data = s->rxq[s->rx_rd++ % RXQ_LEN];
+    return 1;
+}
+
+void SSIIntEnable(uint32_t base, uint32_t f) { SSI *s = ssi_get(base); s->im |= f; tick(); }
+void SSIIntDisable(uint32_t base, uint32_t f) { SSI *s = ssi_get(base); s->im &= ~f; tick(); }
+void SSIIntClear(uint32_t base, uint32_t f) { SSI *s = ssi_get(base); s->ris &= ~f; tick(); }
+
+uint32_t SSIIntStatus(uint32_t base, bool masked)
+{
+    SSI *s = ssi_get(base);
+    uint32_t st;
+    g_now += g_call_ns;
+    st = ssi_status(s);
+    return masked ? (st & s->im) : st;
+}
+
+void SSIIntRegister(uint32_t base, void (*h)(void))
+{
+    SSI *s = ssi_get(base);
+    s->handler = h;
+    s->int_en = true;
+    tick();
+}
+
+void SSIIntUnregister(uint32_t base)
+{
+    SSI *s = ssi_get(base);
+    s->handler = 0;
+    s->int_en = false;
+}
+
+void SSIDMAEnable(uint32_t base, uint32_t f) { ssi_get(base)->dma |= f; tick(); }
+void SSIDMADisable(uint32_t base, uint32_t f) { ssi_get(base)->dma &= ~f; tick(); }
+
+// ----------------------- driverlib: interrupt/CPU -----------------------
+bool IntMasterEnable(void)
+{
+    bool old = !g_master;
+    g_master = true;
+    irq_poll();
+    return old;
+}
+
+bool IntMasterDisable(void)
+{
+    bool old = !g_master;
+    g_master = false;
+    return old;
+}
+
+void IntEnable(uint32_t n) { (void)n; tick(); }
+void IntPendSet(uint32_t n)
+{
+    static const uint32_t ints[NUM_SSI] = { INT_SSI0, INT_SSI1, INT_SSI2, INT_SSI3 };
+    int i;
+    for (i = 0; i < NUM_SSI; i++)
+        if (ints[i] == n) g_ssi[i].pend = true;
+    tick();
+}
+
+uint32_t CPUcpsid(void)
+{
+    uint32_t old = !g_master;
+    g_master = false;
+    return old;
+}
+
+uint32_t CPUcpsie(void)
+{
+    uint32_t old = !g_master;
+    g_master = true;
+    irq_poll();
+    return old;
+}
+void IntDisable(uint32_t n) { (void)n; tick(); }
+void IntPrioritySet(uint32_t n, uint8_t p) { (void)n; (void)p; }
+
+void CPUwfi(void)
+{
+    uint64_t t;
+    int i;
+    for (i = 0; i < NUM_SSI; i++)
+        if (g_ssi[i].pend) { irq_poll(); return; }
+    t = next_event();
+    if (t == UINT64_MAX) fatal("WFI with no pending event");
+    if (t > g_now) g_now = t;
+    dma_service();
+    irq_poll();
+}
+
+// ----------------------- driverlib: SysTick -----------------------
+void SysTickEnable(void)
+{
+    if (!g_st_en) {
+        g_st_base = g_now;
+        g_st_next = g_now + st_period_ns();
+    }
+    g_st_en = true;
+    tick();
+}
+
+void SysTickDisable(void) { g_st_en = false; tick(); }
+void SysTickIntRegister(void (*h)(void)) { g_st_handler = h; g_st_int = true; tick(); }
+void SysTickIntUnregister(void) { g_st_handler = 0; g_st_int = false; }
+void SysTickIntEnable(void) { g_st_int = true; tick(); }
+void SysTickIntDisable(void) { g_st_int = false; tick(); }
+
+void SysTickPeriodSet(uint32_t n)
+{
+    if (n < 2 || n > 16777216) fatal("bad SysTick period");
+    g_st_period = n;
+    g_st_base = g_now;
+    g_st_next = g_now + st_period_ns();
+    tick();
+}
+
+uint32_t SysTickPeriodGet(void) { return g_st_period; }
+
+uint32_t SysTickValueGet(void)
+{
+    uint64_t ticks;
+    g_now += g_call_ns;
+    ticks = (g_now - g_st_base) * g_sysclk / 1000000000ull;
+    return g_st_en ? g_st_period - 1 - (uint32_t)(ticks % g_st_period) : 0;
+}
+
+// ----------------------- driverlib: uDMA -----------------------
+void uDMAEnable(void) { g_dma_on = true; tick(); }
+void uDMADisable(void) { g_dma_on = false; tick(); }
+uint32_t uDMAErrorStatusGet(void) { tick(); return 0; }
+void uDMAErrorStatusClear(void) { tick(); }
+void uDMAControlBaseSet(void *p) { (void)p; tick(); }
+void uDMAChannelAttributeEnable(uint32_t c, uint32_t a) { (void)c; (void)a; tick(); }
+void uDMAChannelAttributeDisable(uint32_t c, uint32_t a) { (void)c; (void)a; tick(); }
+
+void uDMAChannelAssign(uint32_t m)
+{
+    g_dma_map[m & 0x1f] = m >> 16;
+    tick();
+}
+
+void uDMAChannelEnable(uint32_t c)
+{
+    g_dma[c & 0x1f].en = g_dma[c & 0x1f].left != 0;
+    tick();
+}
+
+void uDMAChannelDisable(uint32_t c)
+{
+    g_dma[c & 0x1f].en = false;
+    tick();
+}
+
+bool uDMAChannelIsEnabled(uint32_t c)
+{
+    tick();
+    return g_dma[c & 0x1f].en;
+}
+
+void uDMAChannelControlSet(uint32_t c, uint32_t ctl)
+{
+    if (c & UDMA_ALT_SELECT) fatal("uDMA alternate control not modelled");
+    g_dma[c & 0x1f].ctl = ctl;
+    tick();
+}
+
+void uDMAChannelTransferSet(uint32_t c, uint32_t mode, void *src, void *dst,
+                            uint32_t n)
+{
+    DMACH *d = &g_dma[c & 0x1f];
+    if (mode != UDMA_MODE_BASIC) fatal("uDMA mode not modelled");
+    if (!n || n > 1024) fatal("uDMA transfer size out of range");
+    d->src = src;
+    d->dst = dst;
+    d->left = n;
+    tick();
+}
+
+uint32_t uDMAChannelSizeGet(uint32_t c)
+{
+    tick();
+    return g_dma[c & 0x1f].left;
+}
+
+uint32_t uDMAChannelModeGet(uint32_t c)
+{
+    tick();
+    return g_dma[c & 0x1f].left ? UDMA_MODE_BASIC : UDMA_MODE_STOP;
+}
+
+uint32_t uDMAIntStatus(void) { tick(); return g_dma_chis; }
+void uDMAIntClear(uint32_t m) { g_dma_chis &= ~m; tick(); }
@@ -0,0 +1,95 @@
+//*****************************************************************************
+//
+// sdemu.h - Host-side SD card (SPI mode) emulator.
+//
+// sdemu.c provides the subset of the Tiva driver library used by diskio.c
+// (SSI, GPIO, SysCtl, interrupt, uDMA and SysTick calls) and connects the
+// SSI data registers to a model of an SD card in SPI mode backed by an image
+// file. diskio.c compiles unchanged against it on Linux, so the driver and
+// FatFs can be exercised and timed without hardware.
+//
+// Time is virtual: every SSI frame, driverlib call and card busy period
+// advances a nanosecond clock according to the timing model below, so
+// throughput figures are reproducible from run to run.
+//
+//*****************************************************************************
+
+#ifndef __SDEMU_H__
+#define __SDEMU_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+//*****************************************************************************
+//
+// Timing and behaviour model of one emulated card. sdemu_defaults() fills in
+// figures typical of a class 10 SDHC card.
+//
+//*****************************************************************************
+typedef struct
+{
+    bool     sdhc;              // true: SDHC (block addressing), false: SDSC
+    bool     hs_capable;        // Card supports CMD6 High Speed function
+    uint32_t au_sectors;        // Allocation unit size in sectors
+    uint32_t init_ms;           // Time ACMD41 keeps reporting idle
+    uint32_t max_clk_hz;        // Default speed clock limit
+    uint32_t hs_max_clk_hz;     // Clock limit after switching to High Speed
+    uint32_t err_interval;      // Over the limit: one bit error every n bytes
+    uint32_t cmd_ns;            // Command decode time (R1 delay)
+    uint32_t read_access_us;    // CMD17/CMD18 first block access time
+    uint32_t read_next_us;      // Gap between blocks of CMD18
+    uint32_t prog_single_us;    // Busy time after a CMD24 block
+    uint32_t prog_multi_us;     // Busy time per CMD25 block
+    uint32_t prog_stop_us;      // Busy time after the CMD25 stop token
+    uint32_t misalign_us;       // Extra busy for a write that splits an AU
+    uint32_t erase_au_us;       // CMD38 busy time per AU
+    uint32_t cpu_hz;            // Emulated core clock (SysCtlClockGet)
+    uint32_t call_ns;           // CPU cost of one driverlib call
+    uint32_t ssi_max_hz;        // Fastest SSI master clock of the part
+}
+SDEMU_TIMING;
+
+//*****************************************************************************
+//
+// Per-card counters.
+//
+//*****************************************************************************
+typedef struct
+{
+    uint32_t cmds[64];          // Commands received, by index
+    uint32_t acmds[64];         // Application commands received, by index
+    uint64_t bytes;             // SSI frames exchanged (in bytes)
+    uint64_t sectors_read;
+    uint64_t sectors_written;
+    uint64_t busy_ns;           // Total programming/erase busy time
+    uint32_t crc_errors;        // Command or data CRC errors detected
+    uint32_t bit_errors;        // Bits flipped by an over-limit clock
+    uint32_t overruns;          // SSI RX FIFO overruns caused by the host
+}
+SDEMU_STATS;
+
+//*****************************************************************************
+//
+// Prototypes.
+//
+//*****************************************************************************
+extern void sdemu_defaults(SDEMU_TIMING *psTiming);
+extern int sdemu_attach(uint32_t ui32SSIBase, uint32_t ui32CSPort,
+                        uint8_t ui8CSPin, const char *pcImage,
+                        const SDEMU_TIMING *psTiming);
+extern void sdemu_detach_all(void);
+extern uint64_t sdemu_time_ns(void);
+extern uint32_t sdemu_clock_hz(uint32_t ui32SSIBase);
+extern const SDEMU_STATS *sdemu_stats(uint32_t ui32SSIBase);
+extern void sdemu_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __SDEMU_H__
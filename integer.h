@@ -10,6 +10,29 @@
 #include <windows.h>
 #include <tchar.h>
 
+#elif defined(__unix__) || defined(__APPLE__)	/* POSIX host (host/ builds) */
+
+#include <stdint.h>
+
+/* Fixed widths so that an LP64 host keeps the 32-bit DWORD of the target */
+typedef int				INT;
+typedef unsigned int	UINT;
+
+typedef char			CHAR;
+typedef unsigned char	UCHAR;
+typedef unsigned char	BYTE;
+
+typedef int16_t			SHORT;
+typedef uint16_t		USHORT;
+typedef uint16_t		WORD;
+typedef uint16_t		WCHAR;
+
+typedef int32_t			LONG;
+typedef uint32_t		ULONG;
+typedef uint32_t		DWORD;
+
+typedef enum { FALSE = 0, TRUE } BOOL;
+
 #else			/* Embedded platform */
 
 /* These types must be 16-bit, 32-bit or larger integer */
@@ -4,6 +4,7 @@
 #include "inc/hw_types.h"
 #include "driverlib/sysctl.h"
 #include "driverlib/gpio.h"
+#include "driverlib/systick.h"
 #include "ff.h"
 #include "diskio.h"
 
@@ -54,9 +55,27 @@ void LED(uint8_t r, uint8_t g, uint8_t b)
     GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3, val);
 }
 
+// ---------------- SysTick ----------------
+static volatile uint32_t g_ms;
+
+// 1 ms timebase for Delay_ms() and the SD driver's timeouts
+void SysTickIntHandler(void)
+{
+    g_ms++;
+    disk_timerproc();
+}
+
+void SysTick_Init(void)
+{
+    SysTickPeriodSet(SysCtlClockGet() / 1000);
+    SysTickIntEnable();
+    SysTickEnable();
+}
+
 void Delay_ms(uint32_t ms)
 {
-    SysCtlDelay((SysCtlClockGet()/3000)*ms);
+    uint32_t start = g_ms;
+    while (g_ms - start < ms);
 }
 
 // ---------------- Main ----------------
@@ -71,6 +90,7 @@ int main(void)
     UINT bw;
     SysCtlClockSet(SYSCTL_SYSDIV_2_5 | SYSCTL_USE_PLL |
                    SYSCTL_OSC_MAIN | SYSCTL_XTAL_16MHZ);
+    SysTick_Init();
 
     LED_Init();
     LED(1,1,1); // WHITE: Starting
@@ -122,19 +142,16 @@ int main(void)
 
 
     // APPEND to file
-        f_open(&file, "test.txt", FA_WRITE | FA_OPEN_ALWAYS);  // open or create
-        f_lseek(&file, f_size(&file));                         // move to end of file
+        f_open(&file, "test.txt", FA_WRITE | FA_OPEN_APPEND);  // open or create, at end of file
         f_write(&file, "APPENDED LINE\n", 15, &bw);             // write new data
         f_close(&file);
 
     LED(1,1,0);   // YELLOW: write done
 
-    f_open(&file, "test.txt", FA_WRITE | FA_OPEN_ALWAYS);
+    f_open(&file, "test.txt", FA_WRITE | FA_OPEN_APPEND);   // pointer starts at the end
     int i;
     for ( i = 1; i <= 10; i++)
     {
-        f_lseek(&file, f_size(&file));       // move pointer to end
-
         // convert i into text
         sprintf(line, "%d\n", i);
 